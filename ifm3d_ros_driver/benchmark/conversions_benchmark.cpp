@@ -0,0 +1,292 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+//
+// Measures the `ifm3d_to_ros_*` conversions on synthetic images: every pixel
+// format supported by `ifm3d_to_ros_image()`, the cartesian cloud and the
+// compressed 2D image, at the resolutions of the O3R/O3D imagers and larger
+// ones. Both the overloads filling a recycled message and the allocating
+// ones are measured. Besides the time per frame and the throughput, the heap
+// allocations per call are reported (`allocs_per_call`), counted by
+// replacing the global `operator new` of this executable.
+//
+// Build with `-DBUILD_BENCHMARKS=ON` and run
+// `ifm3d_ros_conversions_benchmark`.
+//
+
+#include <ifm3d_ros_driver/conversions.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/Header.h>
+
+#include <ifm3d/stlimage.h>
+
+namespace
+{
+std::atomic<std::uint64_t> allocations{ 0 };
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size))
+  {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  ::operator delete(ptr);
+}
+
+namespace
+{
+const std::string LOGGER = "benchmark";
+
+struct Resolution
+{
+  const char* name;
+  std::uint32_t width;
+  std::uint32_t height;
+};
+
+const Resolution RESOLUTIONS[] = {
+  { "o3r_38k", 224, 172 },
+  { "o3d", 352, 264 },
+  { "vga", 640, 480 },
+  { "o3r_2d", 1280, 800 },
+};
+constexpr int NUM_RESOLUTIONS = sizeof(RESOLUTIONS) / sizeof(RESOLUTIONS[0]);
+
+struct Format
+{
+  const char* name;
+  ifm3d::pixel_format format;
+  std::uint32_t channels;
+  std::size_t bytes_per_channel;
+};
+
+// the entries of the `image_format_info` table of `ifm3d_to_ros_image()`
+const Format FORMATS[] = {
+  { "8U", ifm3d::pixel_format::FORMAT_8U, 1, 1 },     { "8S", ifm3d::pixel_format::FORMAT_8S, 1, 1 },
+  { "16U", ifm3d::pixel_format::FORMAT_16U, 1, 2 },   { "16S", ifm3d::pixel_format::FORMAT_16S, 1, 2 },
+  { "32U", ifm3d::pixel_format::FORMAT_32U, 1, 4 },   { "32S", ifm3d::pixel_format::FORMAT_32S, 1, 4 },
+  { "32F", ifm3d::pixel_format::FORMAT_32F, 1, 4 },   { "64U", ifm3d::pixel_format::FORMAT_64U, 1, 8 },
+  { "64F", ifm3d::pixel_format::FORMAT_64F, 1, 8 },   { "16U2", ifm3d::pixel_format::FORMAT_16U2, 2, 2 },
+  { "32F3", ifm3d::pixel_format::FORMAT_32F3, 3, 4 },
+};
+constexpr int NUM_FORMATS = sizeof(FORMATS) / sizeof(FORMATS[0]);
+
+// an image of the given format filled with a byte pattern
+ifm3d::Image make_image(const Format& format, const Resolution& resolution)
+{
+  ifm3d::Image image(resolution.width, resolution.height, format.channels, format.format);
+
+  const std::size_t row_bytes = resolution.width * format.channels * format.bytes_per_channel;
+  for (std::uint32_t row = 0; row < resolution.height; ++row)
+  {
+    std::uint8_t* data = image.ptr<std::uint8_t>(row);
+    for (std::size_t i = 0; i < row_bytes; ++i)
+    {
+      data[i] = static_cast<std::uint8_t>(row + i);
+    }
+  }
+
+  return image;
+}
+
+std_msgs::Header make_header()
+{
+  std_msgs::Header header;
+  header.frame_id = "camera_optical_link";
+  return header;
+}
+
+//
+// Reports the throughput and the allocations counted since
+// `allocations_before`
+//
+void SetCounters(benchmark::State& state, const Format& format, const Resolution& resolution,
+                 std::uint64_t allocations_before)
+{
+  const std::uint64_t calls_allocations = allocations.load(std::memory_order_relaxed) - allocations_before;
+  const std::size_t pixels = resolution.width * resolution.height;
+
+  state.SetItemsProcessed(state.iterations() * pixels);
+  state.SetBytesProcessed(state.iterations() * pixels * format.channels * format.bytes_per_channel);
+  state.counters["allocs_per_call"] =
+      benchmark::Counter(static_cast<double>(calls_allocations), benchmark::Counter::kAvgIterations);
+  state.SetLabel(std::string(format.name) + "/" + resolution.name);
+}
+
+void FormatsAndResolutions(benchmark::internal::Benchmark* bench)
+{
+  for (int format = 0; format < NUM_FORMATS; ++format)
+  {
+    for (int resolution = 0; resolution < NUM_RESOLUTIONS; ++resolution)
+    {
+      bench->Args({ format, resolution });
+    }
+  }
+}
+
+void Resolutions(benchmark::internal::Benchmark* bench)
+{
+  for (int resolution = 0; resolution < NUM_RESOLUTIONS; ++resolution)
+  {
+    bench->Arg(resolution);
+  }
+}
+
+//-------------------------------
+// ifm3d_to_ros_image
+//-------------------------------
+void BM_Image(benchmark::State& state)
+{
+  const Format& format = FORMATS[state.range(0)];
+  const Resolution& resolution = RESOLUTIONS[state.range(1)];
+  ifm3d::Image image = make_image(format, resolution);
+  const std_msgs::Header header = make_header();
+  sensor_msgs::Image result;
+
+  const std::uint64_t before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_image(image, header, LOGGER, result);
+    benchmark::DoNotOptimize(result.data.data());
+    benchmark::ClobberMemory();
+  }
+
+  SetCounters(state, format, resolution, before);
+}
+BENCHMARK(BM_Image)->Apply(FormatsAndResolutions);
+
+void BM_ImageAllocating(benchmark::State& state)
+{
+  const Format& format = FORMATS[state.range(0)];
+  const Resolution& resolution = RESOLUTIONS[state.range(1)];
+  ifm3d::Image image = make_image(format, resolution);
+  const std_msgs::Header header = make_header();
+
+  const std::uint64_t before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state)
+  {
+    sensor_msgs::ImagePtr result = ifm3d_to_ros_image(image, header, LOGGER);
+    benchmark::DoNotOptimize(result.get());
+  }
+
+  SetCounters(state, format, resolution, before);
+}
+BENCHMARK(BM_ImageAllocating)->Apply(FormatsAndResolutions);
+
+//-------------------------------
+// ifm3d_to_ros_cloud
+//-------------------------------
+void BM_Cloud(benchmark::State& state)
+{
+  const Format& format = FORMATS[NUM_FORMATS - 1];
+  const Resolution& resolution = RESOLUTIONS[state.range(0)];
+  ifm3d::Image xyz = make_image(format, resolution);
+  const std_msgs::Header header = make_header();
+  sensor_msgs::PointCloud2 result;
+
+  const std::uint64_t before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_cloud(xyz, header, LOGGER, result);
+    benchmark::DoNotOptimize(result.data.data());
+    benchmark::ClobberMemory();
+  }
+
+  SetCounters(state, format, resolution, before);
+}
+BENCHMARK(BM_Cloud)->Apply(Resolutions);
+
+void BM_CloudAllocating(benchmark::State& state)
+{
+  const Format& format = FORMATS[NUM_FORMATS - 1];
+  const Resolution& resolution = RESOLUTIONS[state.range(0)];
+  ifm3d::Image xyz = make_image(format, resolution);
+  const std_msgs::Header header = make_header();
+
+  const std::uint64_t before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state)
+  {
+    sensor_msgs::PointCloud2Ptr result = ifm3d_to_ros_cloud(xyz, header, LOGGER);
+    benchmark::DoNotOptimize(result.get());
+  }
+
+  SetCounters(state, format, resolution, before);
+}
+BENCHMARK(BM_CloudAllocating)->Apply(Resolutions);
+
+//-------------------------------
+// ifm3d_to_ros_compressed_image
+//-------------------------------
+//
+// The JPEG stream is passed through as is, it is modeled by an 8 bit image
+// of a tenth of the pixels of the raw image
+//
+void BM_CompressedImage(benchmark::State& state)
+{
+  const Format& format = FORMATS[0];
+  const Resolution& raw = RESOLUTIONS[state.range(0)];
+  const Resolution resolution{ raw.name, raw.width / 10, raw.height };
+  ifm3d::Image jpeg = make_image(format, resolution);
+  const std_msgs::Header header = make_header();
+  sensor_msgs::CompressedImage result;
+
+  const std::uint64_t before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_compressed_image(jpeg, header, "jpeg", LOGGER, result);
+    benchmark::DoNotOptimize(result.data.data());
+    benchmark::ClobberMemory();
+  }
+
+  SetCounters(state, format, resolution, before);
+}
+BENCHMARK(BM_CompressedImage)->Apply(Resolutions);
+
+void BM_CompressedImageAllocating(benchmark::State& state)
+{
+  const Format& format = FORMATS[0];
+  const Resolution& raw = RESOLUTIONS[state.range(0)];
+  const Resolution resolution{ raw.name, raw.width / 10, raw.height };
+  ifm3d::Image jpeg = make_image(format, resolution);
+  const std_msgs::Header header = make_header();
+
+  const std::uint64_t before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : state)
+  {
+    sensor_msgs::CompressedImagePtr result = ifm3d_to_ros_compressed_image(jpeg, header, "jpeg", LOGGER);
+    benchmark::DoNotOptimize(result.get());
+  }
+
+  SetCounters(state, format, resolution, before);
+}
+BENCHMARK(BM_CompressedImageAllocating)->Apply(Resolutions);
+
+}  // namespace
+
+BENCHMARK_MAIN();
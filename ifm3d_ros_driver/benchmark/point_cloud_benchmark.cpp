@@ -0,0 +1,255 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+//
+// Compares the two ways of producing the organized `cloud`: copying the
+// cartesian image streamed by the camera (`IMG_CART`) and computing it on the
+// host from the unit vectors and the radial distance image
+// (`compute_cartesian`), each with and without masking the invalid pixels
+// (`mask_invalid_points`). Also measures the compaction, the interleaving of
+// extra fields and the merging of the clouds of several heads.
+//
+// Build with `-DBUILD_BENCHMARKS=ON` and run `ifm3d_ros_benchmark`.
+//
+
+#include <ifm3d_ros_driver/conversions.h>
+#include <ifm3d_ros_driver/point_cloud_kernels.h>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <boost/make_shared.hpp>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/Header.h>
+
+#include <ifm3d/stlimage.h>
+
+namespace
+{
+// O3R 38k imager
+constexpr std::uint32_t WIDTH = 224;
+constexpr std::uint32_t HEIGHT = 172;
+
+const std::string LOGGER = "benchmark";
+
+struct Scene
+{
+  Scene()
+    : uvec(WIDTH, HEIGHT, 3, ifm3d::pixel_format::FORMAT_32F3)
+    , distance(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_32F)
+    , xyz(WIDTH, HEIGHT, 3, ifm3d::pixel_format::FORMAT_32F3)
+    , confidence(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_16U)
+    , extrinsics{ 100.0f, -50.0f, 300.0f, 0.0f, 0.0f, 0.0f }
+  {
+    for (std::uint32_t row = 0; row < HEIGHT; ++row)
+    {
+      float* u = this->uvec.ptr<float>(row);
+      float* d = this->distance.ptr<float>(row);
+      float* p = this->xyz.ptr<float>(row);
+      std::uint16_t* c = this->confidence.ptr<std::uint16_t>(row);
+
+      for (std::uint32_t col = 0; col < WIDTH; ++col)
+      {
+        // a pinhole-like field of view, every 16th pixel invalid
+        const float ex = (static_cast<float>(col) - WIDTH / 2.0f) / WIDTH;
+        const float ey = (static_cast<float>(row) - HEIGHT / 2.0f) / WIDTH;
+        const float norm = std::sqrt(ex * ex + ey * ey + 1.0f);
+        u[3 * col + 0] = ex / norm;
+        u[3 * col + 1] = ey / norm;
+        u[3 * col + 2] = 1.0f / norm;
+
+        const bool invalid = (row * WIDTH + col) % 16 == 0;
+        d[col] = invalid ? 0.0f : 1.0f + static_cast<float>(col % 32) * 0.1f;
+        c[col] = invalid ? 0x1 : 0x0;
+
+        // like the camera: the optical frame rotated into x forward, y left, z up, the translation in mm
+        p[3 * col + 0] = u[3 * col + 2] * d[col] + this->extrinsics[2] / 1000.0f;
+        p[3 * col + 1] = -(u[3 * col + 0] * d[col] + this->extrinsics[0] / 1000.0f);
+        p[3 * col + 2] = -(u[3 * col + 1] * d[col] + this->extrinsics[1] / 1000.0f);
+      }
+    }
+
+    this->cloud_uvec = camera_frame_unit_vectors(this->uvec, LOGGER);
+
+    this->header.frame_id = "camera_link";
+  }
+
+  ifm3d::Image uvec;
+  ifm3d::Image distance;
+  ifm3d::Image xyz;
+  ifm3d::Image confidence;
+  std::vector<float> extrinsics;
+  std::vector<float> cloud_uvec;
+  std_msgs::Header header;
+};
+
+void SetCounters(benchmark::State& state, std::size_t bytes_per_frame)
+{
+  state.SetItemsProcessed(state.iterations() * WIDTH * HEIGHT);
+  state.SetBytesProcessed(state.iterations() * bytes_per_frame);
+}
+
+void BM_ComputeXYZ(benchmark::State& state)
+{
+  Scene scene;
+  std::vector<float> out(3 * WIDTH * HEIGHT);
+  const ifm3d_ros::Confidence confidence;
+
+  for (auto _ : state)
+  {
+    ifm3d_ros::ComputeXYZ(scene.cloud_uvec.data(), scene.distance.ptr<float>(0), scene.extrinsics.data(), confidence,
+                          out.data(), WIDTH * HEIGHT);
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+
+  SetCounters(state, WIDTH * HEIGHT * sizeof(float) * 7);
+}
+BENCHMARK(BM_ComputeXYZ);
+
+void BM_CloudFromCartesian(benchmark::State& state)
+{
+  Scene scene;
+  sensor_msgs::PointCloud2 msg;
+
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_cloud(scene.xyz, scene.header, LOGGER, msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+
+  SetCounters(state, WIDTH * HEIGHT * sizeof(float) * 6);
+}
+BENCHMARK(BM_CloudFromCartesian);
+
+void BM_CloudFromUnitVectors(benchmark::State& state)
+{
+  Scene scene;
+  sensor_msgs::PointCloud2 msg;
+
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_cloud(scene.cloud_uvec, scene.distance, scene.extrinsics, scene.header, LOGGER, msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+
+  SetCounters(state, WIDTH * HEIGHT * sizeof(float) * 7);
+}
+BENCHMARK(BM_CloudFromUnitVectors);
+
+void BM_CloudFromCartesianMasked(benchmark::State& state)
+{
+  Scene scene;
+  sensor_msgs::PointCloud2 msg;
+
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_cloud(scene.xyz, scene.confidence, 0x1, scene.header, LOGGER, msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+
+  SetCounters(state, WIDTH * HEIGHT * (sizeof(float) * 6 + sizeof(std::uint16_t)));
+}
+BENCHMARK(BM_CloudFromCartesianMasked);
+
+void BM_CloudFromUnitVectorsMasked(benchmark::State& state)
+{
+  Scene scene;
+  sensor_msgs::PointCloud2 msg;
+
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_cloud(scene.cloud_uvec, scene.distance, scene.extrinsics, scene.confidence, 0x1, scene.header, LOGGER,
+                       msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+
+  SetCounters(state, WIDTH * HEIGHT * (sizeof(float) * 7 + sizeof(std::uint16_t)));
+}
+BENCHMARK(BM_CloudFromUnitVectorsMasked);
+
+void BM_SparseCloud(benchmark::State& state)
+{
+  Scene scene;
+  sensor_msgs::PointCloud2 organized;
+  sensor_msgs::PointCloud2 msg;
+  const bool pixel_index = state.range(0) != 0;
+  ifm3d_to_ros_cloud(scene.xyz, scene.confidence, 0x1, scene.header, LOGGER, organized);
+
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_sparse_cloud(organized, pixel_index, msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+
+  SetCounters(state, organized.data.size() + msg.data.size());
+}
+BENCHMARK(BM_SparseCloud)->Arg(0)->Arg(1);
+
+// arg: number of extra fields, 1 is an XYZI cloud
+void BM_CloudFields(benchmark::State& state)
+{
+  Scene scene;
+  sensor_msgs::PointCloud2 organized;
+  sensor_msgs::PointCloud2 msg;
+  ifm3d_to_ros_cloud(scene.xyz, scene.header, LOGGER, organized);
+
+  const std::vector<std::string> all_fields = { "intensity", "confidence", "distance_noise" };
+  const std::vector<std::string> extra_fields(all_fields.begin(), all_fields.begin() + state.range(0));
+  const auto fields = make_cloud_fields(extra_fields);
+  std::vector<ifm3d::Image> images;
+  for (const auto& name : extra_fields)
+  {
+    images.push_back(name == "confidence" ? scene.confidence : scene.distance);
+  }
+
+  for (auto _ : state)
+  {
+    ifm3d_to_ros_cloud(organized, fields, images, LOGGER, msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+
+  SetCounters(state, organized.data.size() + msg.data.size());
+}
+BENCHMARK(BM_CloudFields)->DenseRange(1, 3);
+
+// arg: number of heads merged, each transformed by a rotation about z
+void BM_MergeClouds(benchmark::State& state)
+{
+  Scene scene;
+  sensor_msgs::PointCloud2 organized;
+  sensor_msgs::PointCloud2 msg;
+  ifm3d_to_ros_cloud(scene.xyz, scene.header, LOGGER, organized);
+
+  const auto heads = static_cast<std::size_t>(state.range(0));
+  std::vector<sensor_msgs::PointCloud2ConstPtr> clouds;
+  std::vector<std::array<float, 16>> transforms;
+  for (std::size_t i = 0; i < heads; ++i)
+  {
+    const float angle = static_cast<float>(i) * 1.0f;
+    clouds.push_back(boost::make_shared<sensor_msgs::PointCloud2>(organized));
+    transforms.push_back({ std::cos(angle), -std::sin(angle), 0.0f, 0.1f, std::sin(angle), std::cos(angle), 0.0f, 0.0f,
+                           0.0f, 0.0f, 1.0f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f });
+  }
+
+  for (auto _ : state)
+  {
+    merge_clouds(clouds, transforms, scene.header, LOGGER, msg);
+    benchmark::DoNotOptimize(msg.data.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * heads * WIDTH * HEIGHT);
+  state.SetBytesProcessed(state.iterations() * 2 * msg.data.size());
+}
+BENCHMARK(BM_MergeClouds)->Arg(2)->Arg(4)->Arg(6);
+
+}  // namespace
+
+BENCHMARK_MAIN();
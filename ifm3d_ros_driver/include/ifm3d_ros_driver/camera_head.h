@@ -0,0 +1,486 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_CAMERA_HEAD_H__
+#define __IFM3D_ROS_CAMERA_HEAD_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <diagnostic_updater/publisher.h>
+#include <image_transport/image_transport.h>
+#include <ros/ros.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
+
+#include <ifm3d/camera/camera_base.h>
+#include <ifm3d/fg.h>
+#include <ifm3d/stlimage.h>
+#include <ifm3d_ros_msgs/Extrinsics.h>
+#include <ifm3d_ros_msgs/SoftOff.h>
+#include <ifm3d_ros_msgs/SoftOn.h>
+#include <ifm3d_ros_msgs/Trigger.h>
+#include <ifm3d_ros_driver/clock_estimator.h>
+#include <ifm3d_ros_driver/frame_drop_detector.h>
+#include <ifm3d_ros_driver/frame_recording.h>
+#include <ifm3d_ros_driver/frame_source.h>
+#include <ifm3d_ros_driver/latency_histogram.h>
+#include <ifm3d_ros_driver/message_pool.h>
+#include <ifm3d_ros_driver/reconnect.h>
+#include <ifm3d_ros_driver/spsc_queue.h>
+#include <ifm3d_ros_driver/thread_policy.h>
+
+namespace ifm3d_ros
+{
+/**
+ * The control plane of a camera (VPU), shared by all of its heads: a single
+ * XMLRPC client, which is only used with `mutex` held.
+ */
+struct CameraControl
+{
+  std::string ip;
+  std::uint16_t xmlrpc_port;
+  std::string password;
+
+  // the heads are served by mocked or replayed frame sources, there is no camera to connect to
+  bool mock = false;
+
+  std::mutex mutex;
+  ifm3d::CameraBase::Ptr cam;
+
+  /**
+   * Returns the XMLRPC client, connecting first if there is none yet or if
+   * `stale` (the client which failed the caller) is still the current one,
+   * i.e. heads failing at the same time reconnect only once. Requires
+   * `mutex` to be held, throws `ifm3d::error_t` if the camera is not
+   * reachable and `std::runtime_error` if it is mocked.
+   */
+  ifm3d::CameraBase::Ptr Connect(const ifm3d::CameraBase::Ptr& stale = nullptr);
+};
+
+/**
+ * The data plane of a single camera head (PCIC port): acquires its frames,
+ * converts and publishes them and offers the services acting on this head
+ * only. Runs its acquisition, conversion and publish stages on threads of
+ * its own once `Start()` was called.
+ */
+class CameraHead
+{
+public:
+  /**
+   * Topics and services are created in `nh`, parameters are looked up in
+   * `nh` first and then in `np`, the private namespace of the nodelet.
+   * `port` is the name of the head in the camera's configuration (e.g.
+   * "port2"), `name` the one used for logging. The services and the timers
+   * are served from `service_queue`, apart from the streaming threads.
+   */
+  CameraHead(std::shared_ptr<CameraControl> control, const std::string& port, std::uint16_t pcic_port,
+             const std::string& frame_id_base, const std::string& name, const ros::NodeHandle& np,
+             const ros::NodeHandle& nh, ros::CallbackQueueInterface* service_queue);
+  ~CameraHead();
+
+  CameraHead(const CameraHead&) = delete;
+  CameraHead& operator=(const CameraHead&) = delete;
+
+  void Start();
+
+  // named like `nodelet::Nodelet::getName()`, so that the NODELET_* logging macros can be used
+  const std::string& getName() const
+  {
+    return this->name_;
+  }
+
+private:
+  template <typename T>
+  void Param(const std::string& key, T& value, const T& default_value)
+  {
+    if (!this->nh_.getParam(key, value))
+    {
+      this->np_.param(key, value, default_value);
+    }
+  }
+
+  //
+  // ROS services
+  //
+  bool Trigger(ifm3d_ros_msgs::Trigger::Request& req, ifm3d_ros_msgs::Trigger::Response& res);
+  bool SoftOff(ifm3d_ros_msgs::SoftOff::Request& req, ifm3d_ros_msgs::SoftOff::Response& res);
+  bool SoftOn(ifm3d_ros_msgs::SoftOn::Request& req, ifm3d_ros_msgs::SoftOn::Response& res);
+
+  //
+  // Data handed between the pipeline stages: raw frames from the acquisition
+  // to the conversion stage and ready-to-publish messages from the
+  // conversion to the publish stage. Empty pointers mean "don't publish".
+  //
+  struct Frame
+  {
+    ifm3d::StlImageBuffer::Ptr buffer;
+    ros::Time received;
+    std::chrono::steady_clock::time_point acquired;
+    std::uint64_t sequence;  // number of the frame received by the acquisition loop
+    std::uint32_t stream;    // changes whenever the stream was restarted or the head switched on or off
+    bool has_count;
+    std::uint32_t count;  // the camera's frame counter, if `has_count`
+    std::uint64_t trigger_id;  // 0 if not matched to a software trigger
+    std::chrono::steady_clock::time_point triggered;
+  };
+
+  struct ConvertedFrame
+  {
+    sensor_msgs::ImagePtr confidence;
+    sensor_msgs::PointCloud2Ptr cloud;
+    sensor_msgs::PointCloud2Ptr cloud_sparse;
+    sensor_msgs::ImagePtr distance;
+    sensor_msgs::ImagePtr distance_noise;
+    sensor_msgs::ImagePtr amplitude;
+    sensor_msgs::ImagePtr raw_amplitude;
+    sensor_msgs::ImagePtr gray;
+    sensor_msgs::CompressedImagePtr rgb;
+    ifm3d_ros_msgs::ExtrinsicsPtr extrinsics;
+    ros::Time stamp;
+    std::chrono::steady_clock::time_point acquired;
+    std::uint64_t trigger_id;
+    std::chrono::steady_clock::time_point triggered;
+  };
+
+  //
+  // This is our main acquisition loop, the conversion and publish stages
+  // and their helper functions
+  //
+  void Run();
+  void ConversionLoop();
+  void PublishLoop();
+  bool Convert(Frame& frame, ConvertedFrame& out);
+  // the organized cloud, with the extra fields of `cloud_fields_` if `rich`
+  void BuildCloud(Frame& frame, ifm3d::Image& confidence, std::uint16_t invalid_bits, bool rich,
+                  const std_msgs::Header& head, sensor_msgs::PointCloud2& cloud);
+  void Recycle(ifm3d::StlImageBuffer::Ptr& buffer);
+  bool InitStructures(std::uint16_t mask, bool reconnect);
+  bool AcquireFrame(long timeout_millis);
+  bool ResetFrameGrabber(std::uint16_t mask);
+  bool Reconnect(std::uint16_t mask);
+  bool WaitBackoff(Backoff& backoff);
+  FrameSource::Ptr MakeFrameSource(std::uint16_t mask);
+  std::uint16_t StreamedSchemaMask(std::uint16_t mask) const;
+  std::uint16_t SubscribedSchemaMask();
+  void UpdateSchemaMask();
+  void PublishStats(const ros::WallTimerEvent& ev);
+  ros::Time Stamp(const Frame& frame);
+  void CountDrops(const Frame& frame);
+  void SetUpThread(const char* stage, const ThreadPolicy& policy, ThreadUsage& usage);
+  void PrefaultPools();
+
+  //
+  // The unit vectors: looked up in the cache or fetched on a connection of
+  // their own, so that the stream starts with the user's schema mask
+  // right away
+  //
+  bool LookupUnitVectors();
+  void FetchUnitVectors(const std::string& key);
+  void PublishUnitVectors(const ifm3d::Image& uvec, const ros::Time& stamp);
+
+  //
+  // Software triggered acquisition
+  //
+  bool IssueTrigger(std::uint64_t& id);
+  void AwaitTriggers();
+  void WakeAcquisition();
+  long IssueTriggers(bool startup, long timeout_millis);
+  std::uint64_t MatchTrigger(std::chrono::steady_clock::time_point received,
+                             std::chrono::steady_clock::time_point& triggered);
+  void ExpireTriggers();
+  void ClearTriggers();
+  void DiagnoseConnection(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+  //
+  // state
+  //
+  std::string name_;
+  std::string port_;
+  std::uint16_t pcic_port_;
+  std::uint16_t schema_mask_;
+  std::atomic<int> timeout_millis_;
+  std::atomic<double> timeout_tolerance_secs_;
+  std::atomic<bool> assume_sw_triggered_;
+  std::atomic<bool> soft_off_{ false };  // the head was set to IDLE by `SoftOff`
+  int soft_on_timeout_millis_;
+  double soft_on_timeout_tolerance_secs_;
+  int soft_off_timeout_millis_;
+  double soft_off_timeout_tolerance_secs_;
+  float frame_latency_thresh_;
+  bool estimate_clock_offset_;
+  int buffer_pool_depth_;
+  bool dynamic_schema_mask_;
+  double schema_mask_debounce_secs_;
+  int pipeline_queue_depth_;
+  bool pipeline_latest_only_;
+  bool compute_cartesian_;
+  bool mask_invalid_points_;
+  std::uint16_t confidence_invalid_bits_;
+  bool sparse_cloud_pixel_index_;
+  double mock_rate_;
+  int mock_width_;
+  int mock_height_;
+  std::string replay_dir_;
+  double replay_speed_;
+  bool replay_loop_;
+  double trigger_rate_;
+  int trigger_max_pending_;
+  int reconnect_probe_timeout_millis_;
+  int reconnect_probe_after_timeouts_;
+  ThreadPolicy streaming_policy_;   // of the acquisition loop
+  ThreadPolicy conversion_policy_;  // of the conversion (decode) stage
+  bool lock_memory_;
+
+  //
+  // The extra fields of the cloud, their (cached) descriptors and the images
+  // they are filled from, which are streamed along with the cartesian data
+  //
+  std::vector<std::string> cloud_field_names_;
+  std::vector<sensor_msgs::PointField> cloud_fields_;
+  std::uint16_t cloud_fields_mask_;
+
+  //
+  // The schema mask currently requested from the framegrabber (the streamed
+  // one may differ, see `StreamedSchemaMask()`) and, if
+  // `dynamic_schema_mask_` is set, the mask derived from the subscriptions
+  // which is waiting for its debounce period to pass.
+  //
+  std::atomic<std::uint16_t> active_mask_;
+  std::uint16_t pending_mask_;
+  ros::WallTime pending_mask_since_;
+
+  std::string frame_id_;
+  std::string optical_frame_id_;
+
+  //
+  // The control plane (`control_`, shared with the other heads, used by the
+  // services and for connecting) and the data plane (`fg_` and `im_`, owned
+  // by the acquisition loop) are synchronized independently, so that slow
+  // XMLRPC calls never stall the frame delivery and vice versa. `cam_` is
+  // the client the framegrabber was created with (none if the camera is
+  // mocked). Other threads only access `fg_` through the atomic shared_ptr
+  // functions.
+  //
+  std::shared_ptr<CameraControl> control_;
+  ifm3d::CameraBase::Ptr cam_;
+  FrameSource::Ptr fg_;
+  ifm3d::StlImageBuffer::Ptr im_;
+
+  //
+  // Recording of the raw frames and the replay of a recording, which is kept
+  // across restarts of the framegrabber. Both belong to the acquisition
+  // loop.
+  //
+  std::unique_ptr<FrameRecorder> recorder_;
+  FrameSource::Ptr replay_;
+
+  // none if disabled or if the camera is mocked
+  std::unique_ptr<UnitVectorCache> uvec_cache_;
+
+  ros::NodeHandle np_;
+  ros::NodeHandle nh_;
+  ros::NodeHandle service_nh_;  // `nh_` on the service queue
+  std::unique_ptr<image_transport::ImageTransport> it_;
+
+  //
+  // Topics we publish
+  //
+  ros::Publisher cloud_pub_;
+  ros::Publisher cloud_sparse_pub_;
+  ros::Publisher uvec_pub_;
+  ros::Publisher extrinsics_pub_;
+  image_transport::Publisher distance_pub_;
+  image_transport::Publisher distance_noise_pub_;
+  image_transport::Publisher amplitude_pub_;
+  image_transport::Publisher raw_amplitude_pub_;
+  image_transport::Publisher conf_pub_;
+  image_transport::Publisher gray_image_pub_;
+  ros::Publisher rgb_image_pub_;
+  ros::Publisher pool_allocations_pub_;
+  ros::Publisher pipeline_pub_;
+  ros::Publisher clock_status_pub_;
+  ros::Publisher stats_pub_;
+  ros::Publisher triggered_frames_pub_;
+
+  //
+  // Recycled message storage, one pool per topic
+  //
+  MessagePool<sensor_msgs::PointCloud2>::Ptr cloud_pool_;
+  MessagePool<sensor_msgs::PointCloud2>::Ptr cloud_sparse_pool_;
+  MessagePool<sensor_msgs::Image>::Ptr distance_pool_;
+  MessagePool<sensor_msgs::Image>::Ptr distance_noise_pool_;
+  MessagePool<sensor_msgs::Image>::Ptr amplitude_pool_;
+  MessagePool<sensor_msgs::Image>::Ptr raw_amplitude_pool_;
+  MessagePool<sensor_msgs::Image>::Ptr conf_pool_;
+  MessagePool<sensor_msgs::Image>::Ptr gray_image_pool_;
+  MessagePool<sensor_msgs::CompressedImage>::Ptr rgb_image_pool_;
+  MessagePool<ifm3d_ros_msgs::Extrinsics>::Ptr extrinsics_pool_;
+
+  //
+  // Services we advertise
+  //
+  ros::ServiceServer trigger_srv_;
+  ros::ServiceServer soft_off_srv_;
+  ros::ServiceServer soft_on_srv_;
+
+  //
+  // The acquisition loop (`Run()`) feeds the conversion thread, which feeds
+  // the publish thread, through bounded queues. Image buffers travel back to
+  // the acquisition loop once their data has been converted.
+  //
+  std::unique_ptr<SpscQueue<Frame>> conversion_queue_;
+  std::unique_ptr<SpscQueue<ConvertedFrame>> publish_queue_;
+  std::unique_ptr<SpscQueue<ifm3d::StlImageBuffer::Ptr>> recycle_queue_;
+  std::thread acquisition_thread_;
+  std::thread conversion_thread_;
+  std::thread publish_thread_;
+  std::thread uvec_thread_;  // fetches the unit vectors on a cache miss
+  Backoff uvec_backoff_;     // only touched by `uvec_thread_`
+  std::atomic<bool> running_{ false };
+  std::atomic<std::uint64_t> acquired_frames_{ 0 };
+  std::atomic<std::uint64_t> conversion_dropped_frames_{ 0 };
+  std::atomic<std::uint64_t> publish_dropped_frames_{ 0 };
+  std::atomic<std::uint64_t> published_frames_{ 0 };
+  std::atomic<std::uint64_t> timeouts_{ 0 };
+  std::atomic<std::uint64_t> reconnects_{ 0 };
+  std::atomic<std::uint64_t> camera_dropped_frames_{ 0 };
+  std::atomic<double> frame_period_{ 0.0 };
+
+  // only touched by the acquisition loop
+  std::uint32_t stream_{ 0 };
+
+  //
+  // Recovery of the stream, see `Reconnect()`. `recovering_since_` is the
+  // time the loss of the stream was detected, the reconnect time measures
+  // from there to the first frame afterwards. Only touched by the
+  // acquisition loop, except for the counters.
+  //
+  Backoff backoff_;
+  bool recovering_{ false };
+  bool link_lost_{ false };      // the head was not reachable, retry on every timeout until a frame arrives
+  bool restarted_fast_{ false };  // the last attempt restarted the framegrabber only
+  std::chrono::steady_clock::time_point recovering_since_;
+  std::atomic<std::uint64_t> fast_reconnects_{ 0 };
+  std::atomic<double> last_reconnect_time_{ 0.0 };
+  LatencyHistogram reconnect_latency_;
+
+  //
+  // Frames lost by the camera or the network, detected by the conversion
+  // stage. The drop counters as of the previous stats message.
+  //
+  FrameDropDetector drops_;
+  std::uint32_t drops_stream_{ 0 };
+  std::uint64_t last_dropped_frames_{ 0 };
+  std::uint64_t last_camera_dropped_frames_{ 0 };
+
+  //
+  // Durations of the stages of every published frame: `WaitForFrame`, the
+  // extraction of the images from the buffer, their conversion, the
+  // `publish()` calls and the total from the frame's arrival to the end of
+  // its publication. Each histogram is recorded by its stage's thread and
+  // drained by the stats timer.
+  //
+  LatencyHistogram wait_latency_;
+  LatencyHistogram extract_latency_;
+  LatencyHistogram convert_latency_;
+  LatencyHistogram publish_latency_;
+  LatencyHistogram total_latency_;
+
+  //
+  // The software triggers issued but not matched to a frame yet, oldest
+  // first. Triggers are issued by the acquisition loop (`trigger_rate_`)
+  // and the `Trigger` service, the frames are matched to them in the order
+  // they arrive. Triggers older than `timeout_millis_` are expired before a
+  // frame is matched, a frame received before the oldest pending trigger was
+  // issued is not matched at all. `trigger_latency_` measures from the
+  // trigger to the end of the frame's publication. Without `trigger_rate_`,
+  // the acquisition loop sleeps on `trigger_cv_` while no trigger is
+  // pending, which is also notified when the head is stopped or leaves the
+  // triggered mode. The triggers are sent outside of `trigger_mutex_`,
+  // serialized by `sw_trigger_mutex_`.
+  //
+  struct PendingTrigger
+  {
+    std::uint64_t id;
+    std::chrono::steady_clock::time_point issued;
+  };
+
+  std::mutex trigger_mutex_;
+  std::mutex sw_trigger_mutex_;
+  std::condition_variable trigger_cv_;
+  std::deque<PendingTrigger> pending_triggers_;
+  std::uint64_t next_trigger_id_{ 1 };
+  std::chrono::steady_clock::time_point next_trigger_;  // only touched by the acquisition loop
+  std::atomic<std::uint64_t> triggers_{ 0 };
+  std::atomic<std::uint64_t> lost_triggers_{ 0 };
+  LatencyHistogram trigger_latency_;
+
+  //
+  // Diagnostics of the head, published along with the stats. The published
+  // frames are ticked into `frames_diagnostic_` by the publish stage, the
+  // connection is diagnosed from the counters above and the last error of
+  // `WaitForFrame`.
+  //
+  double diagnostics_min_freq_;
+  double diagnostics_max_freq_;
+  std::unique_ptr<diagnostic_updater::Updater> updater_;
+  std::unique_ptr<diagnostic_updater::TopicDiagnostic> frames_diagnostic_;
+  std::mutex error_mutex_;
+  int last_error_code_;
+  std::string last_error_;
+  std::uint64_t diagnosed_frames_;
+  std::uint64_t diagnosed_timeouts_;
+  std::uint64_t diagnosed_camera_dropped_;
+
+  // CPU time and context switches of the stages' threads
+  ThreadUsage acquisition_usage_;
+  ThreadUsage conversion_usage_;
+  ThreadUsage publish_usage_;
+
+  // only touched by the conversion stage
+  std_msgs::Header head_;
+  std_msgs::Header optical_head_;
+  sensor_msgs::PointCloud2 xyz_scratch_;
+  std::vector<ifm3d::Image> cloud_field_images_;
+  std::uint64_t extract_ns_{ 0 };
+
+  // Maps the camera's timestamps to the host's clock. Updated by the
+  // conversion stage, read by the stats timer.
+  std::mutex clock_mutex_;
+  ClockEstimator clock_;
+
+  // Unit vectors fetched at startup, in the frame of the cloud (see
+  // `camera_frame_unit_vectors()`), none until they are known. Written
+  // once, by the acquisition loop or `uvec_thread_`, read-only afterwards.
+  // Accessed through the atomic shared_ptr functions.
+  std::shared_ptr<const std::vector<float>> uvec_;
+
+  //
+  // Periodically reports the allocation counters of the message pools, the
+  // occupancy of the pipeline and the latencies of its stages. With
+  // `lock_memory_`, it also pre-faults the message pools once their
+  // payloads are known.
+  //
+  ros::WallTimer stats_timer_;
+  ros::WallTime last_stats_;
+  bool pools_prefaulted_{ false };
+
+};  // end: class CameraHead
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_CAMERA_HEAD_H__
@@ -8,33 +8,33 @@
 
 #include <cstdint>
 #include <memory>
-#include <mutex>
 #include <string>
+#include <vector>
 
-#include <image_transport/image_transport.h>
 #include <nodelet/nodelet.h>
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 
-#include <ifm3d/camera/camera_base.h>
-#include <ifm3d/fg.h>
-#include <ifm3d/stlimage.h>
 #include <ifm3d_ros_msgs/Config.h>
 #include <ifm3d_ros_msgs/Dump.h>
-#include <ifm3d_ros_msgs/Extrinsics.h>
-#include <ifm3d_ros_msgs/SoftOff.h>
-#include <ifm3d_ros_msgs/SoftOn.h>
-#include <ifm3d_ros_msgs/Trigger.h>
+#include <ifm3d_ros_driver/camera_head.h>
 
 namespace ifm3d_ros
 {
 /**
  * This class implements the ROS nodelet interface to allow for running
  * in-process data transport between ifm3d image data and ROS consumers. This
- * class is used to manage, configure, and acquire data from a single ifm3d
- * camera.
+ * class is used to manage and configure a single ifm3d camera and to acquire
+ * data from one or more of its heads (see `CameraHead`). The services and
+ * timers of the nodelet and its heads are served by a spinner of their own,
+ * i.e. they neither wait for nor delay the streaming threads or the worker
+ * threads of the nodelet manager.
  */
 class CameraNodelet : public nodelet::Nodelet
 {
+public:
+  ~CameraNodelet() override;
+
 private:
   //
   // Nodelet lifecycle functions
@@ -46,70 +46,42 @@ private:
   //
   bool Dump(ifm3d_ros_msgs::Dump::Request& req, ifm3d_ros_msgs::Dump::Response& res);
   bool Config(ifm3d_ros_msgs::Config::Request& req, ifm3d_ros_msgs::Config::Response& res);
-  bool Trigger(ifm3d_ros_msgs::Trigger::Request& req, ifm3d_ros_msgs::Trigger::Response& res);
-  bool SoftOff(ifm3d_ros_msgs::SoftOff::Request& req, ifm3d_ros_msgs::SoftOff::Response& res);
-  bool SoftOn(ifm3d_ros_msgs::SoftOn::Request& req, ifm3d_ros_msgs::SoftOn::Response& res);
 
   //
-  // This is our main publishing loop and its helper functions
+  // Setting up the heads
   //
-  void Run();
-  bool InitStructures(std::uint16_t mask, std::uint16_t pcic_port);
-  bool AcquireFrame();
+  void Start();
+  bool DiscoverHeads();
+  void AddHead(const std::string& port, std::uint16_t pcic_port);
 
   //
   // state
   //
-  std::string camera_ip_;
-  std::uint16_t xmlrpc_port_;
-  std::uint16_t pcic_port_;
-  std::string password_;
-  std::uint16_t schema_mask_;
-  int timeout_millis_;
-  double timeout_tolerance_secs_;
-  bool assume_sw_triggered_;
-  int soft_on_timeout_millis_;
-  double soft_on_timeout_tolerance_secs_;
-  int soft_off_timeout_millis_;
-  double soft_off_timeout_tolerance_secs_;
-  float frame_latency_thresh_;
-
-  std::string frame_id_;
-  std::string optical_frame_id_;
-
-  ifm3d::CameraBase::Ptr cam_;
-  ifm3d::FrameGrabber::Ptr fg_;
-  ifm3d::StlImageBuffer::Ptr im_;
-  std::mutex mutex_;
+  std::string frame_id_base_;
+  bool multi_head_;
+
+  // the control plane shared by all heads
+  std::shared_ptr<CameraControl> control_;
 
   ros::NodeHandle np_;
-  std::unique_ptr<image_transport::ImageTransport> it_;
+  std::vector<std::unique_ptr<CameraHead>> heads_;
 
   //
-  // Topics we publish
+  // The callback queue of the services and timers and its spinner. The
+  // spinner is stopped before the heads are destroyed.
   //
-  ros::Publisher cloud_pub_;
-  ros::Publisher uvec_pub_;
-  ros::Publisher extrinsics_pub_;
-  image_transport::Publisher distance_pub_;
-  image_transport::Publisher distance_noise_pub_;
-  image_transport::Publisher amplitude_pub_;
-  image_transport::Publisher raw_amplitude_pub_;
-  image_transport::Publisher conf_pub_;
-  image_transport::Publisher gray_image_pub_;
-  ros::Publisher rgb_image_pub_;
+  ros::CallbackQueue service_queue_;
+  std::unique_ptr<ros::AsyncSpinner> service_spinner_;
 
   //
   // Services we advertise
   //
   ros::ServiceServer dump_srv_;
   ros::ServiceServer config_srv_;
-  ros::ServiceServer trigger_srv_;
-  ros::ServiceServer soft_off_srv_;
-  ros::ServiceServer soft_on_srv_;
 
   //
-  // We use a ROS one-shot timer to kick off our publishing loop.
+  // We use a ROS one-shot timer to discover the heads (if requested) and to
+  // kick off their publishing loops.
   //
   ros::Timer publoop_timer_;
 
@@ -0,0 +1,81 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_CLOCK_ESTIMATOR_H__
+#define __IFM3D_ROS_CLOCK_ESTIMATOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ifm3d_ros
+{
+/**
+ * Estimates the offset and the drift of the camera's clock relative to the
+ * host's one from pairs of camera timestamps and host receive times, by a
+ * linear regression over a sliding window of frames.
+ *
+ * The receive times carry the latency of the frames, which is always
+ * positive. The fitted line is therefore moved down to the frame with the
+ * lowest latency in the window, i.e. the mapped stamps are the capture
+ * times in the host's clock plus the minimum latency (processing and
+ * transport), without the jitter of the receive times.
+ *
+ * Samples off the fit by more than `reset_thresh_secs` are ignored, unless
+ * they persist: then the camera's clock jumped and the window is restarted.
+ * Not thread-safe.
+ */
+class ClockEstimator
+{
+public:
+  explicit ClockEstimator(std::size_t window = 300, double reset_thresh_secs = 0.5);
+
+  /**
+   * Adds a sample and returns `camera_ns` mapped to the host's clock. The
+   * returned stamps are strictly increasing.
+   */
+  std::int64_t Update(std::int64_t camera_ns, std::int64_t host_ns);
+
+  void Reset();
+
+  // host - camera (seconds) at the latest sample, including the minimum latency
+  double Offset() const;
+  // drift of the camera's clock relative to the host's one (parts per million)
+  double DriftPpm() const;
+  // standard deviation of the latency around the fit (seconds)
+  double Jitter() const;
+  std::size_t Samples() const;
+  std::uint32_t Resets() const;
+
+private:
+  struct Sample
+  {
+    double x;  // camera time relative to `ref_camera_ns_` (seconds)
+    double y;  // host - camera relative to `ref_offset_ns_` (seconds)
+  };
+
+  void Fit();
+  double Predict(double x) const;
+
+  std::size_t window_;
+  double reset_thresh_secs_;
+  std::vector<Sample> samples_;  // ring buffer
+  std::size_t next_ = 0;
+  std::size_t outliers_ = 0;
+  std::uint32_t resets_ = 0;
+
+  std::int64_t ref_camera_ns_ = 0;
+  std::int64_t ref_offset_ns_ = 0;
+  double intercept_ = 0.0;  // of the lower envelope
+  double slope_ = 0.0;
+  double jitter_ = 0.0;
+  double last_x_ = 0.0;
+  std::int64_t last_stamp_ns_ = 0;
+  bool have_stamp_ = false;
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_CLOCK_ESTIMATOR_H__
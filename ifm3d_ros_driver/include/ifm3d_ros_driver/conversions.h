@@ -0,0 +1,137 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_CONVERSIONS_H__
+#define __IFM3D_ROS_CONVERSIONS_H__
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/PointField.h>
+#include <std_msgs/Header.h>
+
+#include <ifm3d/stlimage.h>
+
+//
+// Conversions from ifm3d image data to ROS messages.
+//
+// The overloads taking a `result` message fill it in place. `result` may be
+// a recycled message, the capacity of its data array is kept. The overloads
+// returning a pointer allocate a new message.
+//
+// NOTE: The images are taken by non-const reference because image.begin()
+// and image.end() don't have const overloads.
+//
+
+void ifm3d_to_ros_image(ifm3d::Image& image, const std_msgs::Header& header, const std::string& logger,
+                        sensor_msgs::Image& result);
+void ifm3d_to_ros_image(ifm3d::Image&& image, const std_msgs::Header& header, const std::string& logger,
+                        sensor_msgs::Image& result);
+sensor_msgs::ImagePtr ifm3d_to_ros_image(ifm3d::Image& image, const std_msgs::Header& header,
+                                         const std::string& logger);
+sensor_msgs::ImagePtr ifm3d_to_ros_image(ifm3d::Image&& image, const std_msgs::Header& header,
+                                         const std::string& logger);
+
+// `format` is either "jpeg" or "png"
+void ifm3d_to_ros_compressed_image(ifm3d::Image& image, const std_msgs::Header& header, const std::string& format,
+                                   const std::string& logger, sensor_msgs::CompressedImage& result);
+sensor_msgs::CompressedImagePtr ifm3d_to_ros_compressed_image(ifm3d::Image& image, const std_msgs::Header& header,
+                                                              const std::string& format, const std::string& logger);
+sensor_msgs::CompressedImagePtr ifm3d_to_ros_compressed_image(ifm3d::Image&& image, const std_msgs::Header& header,
+                                                              const std::string& format, const std::string& logger);
+
+// organized x/y/z cloud from the camera's cartesian image
+void ifm3d_to_ros_cloud(ifm3d::Image& image, const std_msgs::Header& header, const std::string& logger,
+                        sensor_msgs::PointCloud2& result);
+void ifm3d_to_ros_cloud(ifm3d::Image&& image, const std_msgs::Header& header, const std::string& logger,
+                        sensor_msgs::PointCloud2& result);
+sensor_msgs::PointCloud2Ptr ifm3d_to_ros_cloud(ifm3d::Image& image, const std_msgs::Header& header,
+                                               const std::string& logger);
+sensor_msgs::PointCloud2Ptr ifm3d_to_ros_cloud(ifm3d::Image&& image, const std_msgs::Header& header,
+                                               const std::string& logger);
+
+//
+// The (rotated) unit vectors streamed by the camera in the frame of its
+// cartesian image, interleaved, as `ifm3d_to_ros_cloud()` takes them. Empty
+// if the image is not a FLOAT32 3 channel one. Meant to be computed once per
+// head.
+//
+std::vector<float> camera_frame_unit_vectors(ifm3d::Image& uvec, const std::string& logger);
+
+//
+// organized x/y/z cloud computed on the host from the unit vectors (see
+// `camera_frame_unit_vectors()`), the radial distance image and the extrinsic
+// calibration (tx, ty, tz in mm of the optical frame, ...), i.e. the same
+// points in the same frame as the camera's cartesian image
+//
+void ifm3d_to_ros_cloud(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result);
+
+//
+// Same as above, but points whose confidence has any of `invalid_bits` set
+// are set to NaN and `is_dense` tells whether there are any. Masking is
+// skipped if `invalid_bits` is 0 or the confidence image is empty.
+//
+void ifm3d_to_ros_cloud(ifm3d::Image& image, ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result);
+void ifm3d_to_ros_cloud(ifm3d::Image&& image, ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result);
+void ifm3d_to_ros_cloud(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                        ifm3d::Image& confidence, std::uint16_t invalid_bits, const std_msgs::Header& header,
+                        const std::string& logger, sensor_msgs::PointCloud2& result);
+
+//
+// Unorganized cloud holding only the points of an organized x/y/z cloud which
+// are not NaN, i.e. `organized` is expected to have its invalid points
+// masked. With `pixel_index`, every point carries the index of its pixel
+// (row * width + column) in a uint32 field "pixel_index".
+//
+void ifm3d_to_ros_sparse_cloud(const sensor_msgs::PointCloud2& organized, bool pixel_index,
+                               sensor_msgs::PointCloud2& result);
+
+//
+// Field descriptors of a cloud with x, y, z followed by one 4 byte field per
+// entry of `extra_fields`: "intensity" (the amplitude, named as PCL expects
+// it), "amplitude" and "distance_noise" are FLOAT32, "confidence" is UINT16.
+// Throws `std::invalid_argument` for unknown names. Meant to be built once and
+// passed to `ifm3d_to_ros_cloud()` for every frame.
+//
+std::vector<sensor_msgs::PointField> make_cloud_fields(const std::vector<std::string>& extra_fields);
+
+// Organized cloud with the layout `fields`, interleaving the points of the
+// x/y/z cloud `xyz` with `images`, one per extra field.
+void ifm3d_to_ros_cloud(const sensor_msgs::PointCloud2& xyz, const std::vector<sensor_msgs::PointField>& fields,
+                        std::vector<ifm3d::Image>& images, const std::string& logger, sensor_msgs::PointCloud2& result);
+
+//
+// Same as above, but the points are taken from the cartesian image or
+// computed from the unit vectors and masked as by the x/y/z-only overloads,
+// block by block while the cloud is written, i.e. without an x/y/z cloud in
+// between.
+//
+void ifm3d_to_ros_cloud(ifm3d::Image& image, ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std::vector<sensor_msgs::PointField>& fields, std::vector<ifm3d::Image>& images,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result);
+void ifm3d_to_ros_cloud(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                        ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std::vector<sensor_msgs::PointField>& fields, std::vector<ifm3d::Image>& images,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result);
+
+//
+// Unorganized x/y/z cloud concatenating the points of `clouds`, the points of
+// `clouds[i]` transformed by the affine part of the row-major 4x4 matrix
+// `transforms[i]`. Clouds which don't start with the FLOAT32 fields x, y and
+// z are skipped. `is_dense` is set if all clouds are dense.
+//
+void merge_clouds(const std::vector<sensor_msgs::PointCloud2ConstPtr>& clouds,
+                  const std::vector<std::array<float, 16>>& transforms, const std_msgs::Header& header,
+                  const std::string& logger, sensor_msgs::PointCloud2& result);
+
+#endif  // __IFM3D_ROS_CONVERSIONS_H__
@@ -0,0 +1,70 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_FRAME_DROP_DETECTOR_H__
+#define __IFM3D_ROS_FRAME_DROP_DETECTOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ifm3d_ros
+{
+/**
+ * Detects frames which the camera produced but the driver never received,
+ * i.e. frames lost by the camera or the network, from the gaps between the
+ * frames reaching the conversion stage.
+ *
+ * A gap is measured by the camera's frame counter if the frames carry one,
+ * otherwise by the camera timestamps relative to the nominal frame period,
+ * the median interval of the latest `window` frames (cadence). The frames
+ * dropped by the driver's own pipeline in between are known from the
+ * acquisition sequence numbers and are not counted. Gaps are ignored while
+ * fewer than `window / 4` intervals were seen and if they are implausibly
+ * large, e.g. after the camera restarted its counter. Not thread-safe.
+ */
+class FrameDropDetector
+{
+public:
+  explicit FrameDropDetector(std::size_t window = 32);
+
+  /**
+   * Adds a frame and returns the frames lost right before it. `sequence`
+   * counts the frames received by the driver. The cadence is only used if
+   * `use_cadence` is set, i.e. not for triggered acquisition.
+   */
+  std::uint64_t Update(std::uint64_t sequence, std::int64_t camera_ns, bool has_count, std::uint32_t count,
+                       bool use_cadence);
+
+  // forgets the previous frame, e.g. after the stream was restarted
+  void Reset();
+
+  // the frames lost so far, over all resets
+  std::uint64_t Dropped() const
+  {
+    return this->dropped_;
+  }
+
+  // nominal frame period (seconds), 0 if not known yet
+  double Period() const;
+
+private:
+  std::size_t window_;
+  std::vector<double> intervals_;  // ring buffer (nanoseconds per frame)
+  std::size_t next_ = 0;
+  mutable std::vector<double> scratch_;
+
+  bool have_last_ = false;
+  std::uint64_t last_sequence_ = 0;
+  std::int64_t last_camera_ns_ = 0;
+  bool last_has_count_ = false;
+  std::uint32_t last_count_ = 0;
+
+  std::uint64_t dropped_ = 0;
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_FRAME_DROP_DETECTOR_H__
@@ -0,0 +1,187 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_FRAME_RECORDING_H__
+#define __IFM3D_ROS_FRAME_RECORDING_H__
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ifm3d/stlimage.h>
+#include <ifm3d_ros_driver/frame_source.h>
+
+namespace ifm3d_ros
+{
+//
+// A recording of the raw PCIC frames of a head is a directory holding
+//
+//  - segment files (`segment_000000.pcic`, ...): the frames' bytes as
+//    received, back to back
+//  - an `index` file: a `RecordingIndexHeader` followed by one
+//    `RecordingIndexEntry` per frame, in the order of reception
+//
+// All values are in the host's byte order.
+//
+struct RecordingIndexHeader
+{
+  char magic[8];  // "IFM3DREC"
+  std::uint32_t version;
+  std::uint32_t reserved;
+};
+
+struct RecordingIndexEntry
+{
+  std::int64_t stamp_ns;  // receive time (system clock, nanoseconds since the epoch)
+  std::uint32_t segment;
+  std::uint32_t size;
+  std::uint64_t offset;  // in the segment
+};
+
+/**
+ * Appends raw frames to a recording. The segments are preallocated and
+ * memory-mapped, i.e. appending a frame is a copy into the page cache and
+ * a write of its index entry; the kernel writes the data back on its own.
+ * A frame is indexed after its data was written, so that the recording is
+ * consistent up to the last indexed frame even if the process dies. Throws
+ * `std::runtime_error` on I/O errors. Not thread-safe. Not to be used in a
+ * process with its memory locked (`mlockall(MCL_FUTURE)`), which would
+ * fault in every segment completely on mapping it.
+ */
+class FrameRecorder
+{
+public:
+  // creates `dir` if needed, which must not contain a recording yet
+  FrameRecorder(const std::string& dir, std::size_t segment_size);
+  ~FrameRecorder();
+
+  FrameRecorder(const FrameRecorder&) = delete;
+  FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+  void Append(const std::vector<std::uint8_t>& bytes, std::int64_t stamp_ns);
+
+  std::uint64_t Frames() const
+  {
+    return this->frames_;
+  }
+
+private:
+  void OpenSegment(std::size_t min_size);
+  void CloseSegment();
+
+  std::string dir_;
+  std::size_t segment_size_;
+  int index_fd_ = -1;
+
+  // the current segment
+  int segment_fd_ = -1;
+  std::uint8_t* segment_ = nullptr;
+  std::size_t segment_capacity_ = 0;
+  std::size_t segment_used_ = 0;
+  std::uint32_t segment_id_ = 0;
+
+  std::uint64_t frames_ = 0;
+};
+
+/**
+ * Feeds the frames of a recording back into the driver, paced like they
+ * were received (scaled by `speed`, as fast as possible if not positive).
+ * The frames are copied from the memory-mapped segments into the buffer,
+ * i.e. they are decoded by ifm3d like the original ones. At the end of the
+ * recording it starts over if `loop` is set, otherwise it times out.
+ * Software triggers are ignored. The constructor throws
+ * `std::runtime_error` if the recording can not be read.
+ */
+class ReplayFrameSource : public FrameSource
+{
+public:
+  ReplayFrameSource(const std::string& dir, double speed, bool loop);
+  ~ReplayFrameSource() override;
+
+  ReplayFrameSource(const ReplayFrameSource&) = delete;
+  ReplayFrameSource& operator=(const ReplayFrameSource&) = delete;
+
+  bool WaitForFrame(ifm3d::StlImageBuffer* buffer, long timeout_millis) override;
+  void SWTrigger() override;
+  bool FrameCount(std::uint32_t& count) const override;
+
+  std::size_t Frames() const
+  {
+    return this->index_.size();
+  }
+
+private:
+  struct Segment
+  {
+    const std::uint8_t* data;
+    std::size_t size;
+  };
+
+  std::vector<Segment> segments_;
+  std::vector<RecordingIndexEntry> index_;
+  double speed_;
+  bool loop_;
+
+  std::size_t next_ = 0;
+  std::chrono::steady_clock::time_point start_;
+  std::int64_t start_stamp_ns_ = 0;
+  bool has_count_ = false;
+  std::uint32_t count_ = 0;
+
+  // swapped with the buffer's storage, so that replaying does not allocate
+  std::vector<std::uint8_t> scratch_;
+};
+
+//
+// A cached unit vector frame is a file holding a `UnitVectorCacheHeader`
+// followed by the raw PCIC frame, in the host's byte order
+//
+struct UnitVectorCacheHeader
+{
+  char magic[8];  // "IFM3DUVC"
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t size;      // of the frame
+  std::uint64_t checksum;  // FNV-1a of the frame
+};
+
+/**
+ * The raw unit vector frames of the heads, persisted across restarts of the
+ * driver. The unit vectors of a head only change with its calibration and
+ * configuration, which is why a frame is looked up by a key made of the
+ * head's serial number, its port and a hash of its configuration, see
+ * `Key()`. Every key is a file in `dir`, which is written atomically, i.e.
+ * concurrent drivers and crashes never leave a partial frame behind.
+ */
+class UnitVectorCache
+{
+public:
+  explicit UnitVectorCache(const std::string& dir);
+
+  static std::string Key(const std::string& serial, const std::string& port, const std::string& config);
+
+  /**
+   * Reads the frame cached for `key` from its memory-mapped file into
+   * `frame`. Returns false if there is none or if it is damaged.
+   */
+  bool Load(const std::string& key, std::vector<std::uint8_t>& frame) const;
+
+  // creates `dir` if needed, throws `std::runtime_error` on I/O errors
+  void Store(const std::string& key, const std::vector<std::uint8_t>& frame) const;
+
+  const std::string& Dir() const
+  {
+    return this->dir_;
+  }
+
+private:
+  std::string dir_;
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_FRAME_RECORDING_H__
@@ -0,0 +1,109 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_FRAME_SOURCE_H__
+#define __IFM3D_ROS_FRAME_SOURCE_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ifm3d/camera/camera_base.h>
+#include <ifm3d/fg.h>
+#include <ifm3d/stlimage.h>
+
+namespace ifm3d_ros
+{
+/**
+ * Where the acquisition loop of a head gets its frames from. `WaitForFrame()`
+ * is only called by the acquisition loop, `SWTrigger()` may be called
+ * concurrently from the services. Both throw `ifm3d::error_t` on errors.
+ */
+class FrameSource
+{
+public:
+  using Ptr = std::shared_ptr<FrameSource>;
+
+  virtual ~FrameSource() = default;
+
+  /**
+   * Waits up to `timeout_millis` (forever if 0) for the next frame and
+   * stores it in `buffer`. Returns false on timeout.
+   */
+  virtual bool WaitForFrame(ifm3d::StlImageBuffer* buffer, long timeout_millis) = 0;
+
+  virtual void SWTrigger() = 0;
+
+  /**
+   * The camera's frame counter of the latest frame, if known to the source.
+   * ifm3d's framegrabber does not expose it.
+   */
+  virtual bool FrameCount(std::uint32_t& /* count */) const
+  {
+    return false;
+  }
+};
+
+/**
+ * The frames of a camera head, streamed over PCIC by an ifm3d framegrabber
+ */
+class FrameGrabberSource : public FrameSource
+{
+public:
+  FrameGrabberSource(ifm3d::CameraBase::Ptr cam, std::uint16_t mask, std::uint16_t pcic_port);
+
+  bool WaitForFrame(ifm3d::StlImageBuffer* buffer, long timeout_millis) override;
+  void SWTrigger() override;
+
+private:
+  ifm3d::FrameGrabber fg_;
+};
+
+/**
+ * Synthetic frames for running the driver without a camera, e.g. for load
+ * testing many heads on a single host. The frames are serialized like the
+ * PCIC stream of an O3R head (ticket, "star", image chunks, "stop"), i.e.
+ * they are decoded by ifm3d like real ones and take the same path through
+ * the driver.
+ *
+ * The scene is a tilted plane in front of a pinhole camera. The frame is
+ * built once for the schema mask, only the frame counter and the
+ * timestamps are updated per frame. With a positive `rate` (Hz) the frames
+ * are delivered at that rate, otherwise one per `SWTrigger()`, i.e. like a
+ * camera, triggers issued back to back are answered with a frame each.
+ */
+class MockFrameSource : public FrameSource
+{
+public:
+  MockFrameSource(std::uint16_t mask, std::uint32_t width, std::uint32_t height, double rate);
+
+  bool WaitForFrame(ifm3d::StlImageBuffer* buffer, long timeout_millis) override;
+  void SWTrigger() override;
+  bool FrameCount(std::uint32_t& count) const override;
+
+private:
+  void AddChunk(std::uint32_t type, std::uint32_t width, std::uint32_t height, std::uint32_t pixel_format,
+                const void* data, std::size_t size);
+  void Stamp();
+
+  std::vector<std::uint8_t> frame_;
+  std::vector<std::size_t> chunks_;  // offsets of the chunk headers in `frame_`
+  std::uint32_t frame_count_ = 0;
+
+  std::chrono::steady_clock::duration period_;
+  std::chrono::steady_clock::time_point next_;
+
+  std::mutex mutex_;
+  std::condition_variable triggered_cv_;
+  std::size_t pending_triggers_ = 0;  // every trigger is answered with a frame of its own
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_FRAME_SOURCE_H__
@@ -0,0 +1,155 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_LATENCY_HISTOGRAM_H__
+#define __IFM3D_ROS_LATENCY_HISTOGRAM_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace ifm3d_ros
+{
+/**
+ * Lock-free histogram of durations (nanoseconds) with logarithmic buckets,
+ * each power of two being split into 32 linear sub-buckets, i.e. values are
+ * resolved with a relative error below 1/32 from 1 ns up to about 20 hours.
+ *
+ * Recording is a single relaxed atomic increment and never blocks or
+ * allocates. `Drain()` summarizes the values recorded since its previous
+ * call and may run concurrently: a value recorded meanwhile is accounted to
+ * either this or the next summary.
+ */
+class LatencyHistogram
+{
+public:
+  struct Summary
+  {
+    std::uint64_t count;
+    // upper bounds of the buckets containing the percentiles (nanoseconds)
+    std::uint64_t p50;
+    std::uint64_t p90;
+    std::uint64_t p99;
+    std::uint64_t max;
+  };
+
+  LatencyHistogram()
+  {
+    for (auto& count : this->counts_)
+    {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void Record(std::uint64_t ns)
+  {
+    this->counts_[Index(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    auto max = this->max_.load(std::memory_order_relaxed);
+    while ((ns > max) && !this->max_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  // records the time elapsed since `start`
+  void Record(std::chrono::steady_clock::time_point start)
+  {
+    this->Record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+  }
+
+  Summary Drain()
+  {
+    std::array<std::uint64_t, BUCKETS> counts;
+    Summary summary{ 0, 0, 0, 0, 0 };
+    for (std::size_t i = 0; i < BUCKETS; ++i)
+    {
+      counts[i] = this->counts_[i].exchange(0, std::memory_order_relaxed);
+      summary.count += counts[i];
+    }
+    summary.max = this->max_.exchange(0, std::memory_order_relaxed);
+
+    if (summary.count == 0)
+    {
+      return summary;
+    }
+
+    // ranks of the percentiles, rounded up
+    const std::uint64_t p50_rank = (summary.count * 50 + 99) / 100;
+    const std::uint64_t p90_rank = (summary.count * 90 + 99) / 100;
+    const std::uint64_t p99_rank = (summary.count * 99 + 99) / 100;
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; (i < BUCKETS) && (seen < p99_rank); ++i)
+    {
+      if (counts[i] == 0)
+      {
+        continue;
+      }
+
+      const std::uint64_t previous = seen;
+      seen += counts[i];
+      const std::uint64_t upper = UpperBound(i);
+      summary.p50 = ((previous < p50_rank) && (seen >= p50_rank)) ? upper : summary.p50;
+      summary.p90 = ((previous < p90_rank) && (seen >= p90_rank)) ? upper : summary.p90;
+      summary.p99 = ((previous < p99_rank) && (seen >= p99_rank)) ? upper : summary.p99;
+    }
+
+    // the bucket bounds may exceed the largest value
+    summary.p50 = std::min(summary.p50, summary.max);
+    summary.p90 = std::min(summary.p90, summary.max);
+    summary.p99 = std::min(summary.p99, summary.max);
+    return summary;
+  }
+
+private:
+  static constexpr unsigned SUB_BUCKET_BITS = 5;
+  static constexpr std::uint64_t SUB_BUCKETS = std::uint64_t(1) << SUB_BUCKET_BITS;
+  static constexpr unsigned MAX_SHIFT = 40;
+  static constexpr std::size_t BUCKETS = (MAX_SHIFT + 2) * SUB_BUCKETS;
+
+  // values below `SUB_BUCKETS` map to themselves, larger ones to their
+  // top `SUB_BUCKET_BITS + 1` bits, offset by their magnitude
+  static std::size_t Index(std::uint64_t ns)
+  {
+    if (ns < SUB_BUCKETS)
+    {
+      return static_cast<std::size_t>(ns);
+    }
+
+    const unsigned shift = (63u - static_cast<unsigned>(__builtin_clzll(ns))) - SUB_BUCKET_BITS;
+    if (shift > MAX_SHIFT)
+    {
+      return BUCKETS - 1;
+    }
+
+    return static_cast<std::size_t>(shift * SUB_BUCKETS + (ns >> shift));
+  }
+
+  static std::uint64_t UpperBound(std::size_t index)
+  {
+    if (index < SUB_BUCKETS)
+    {
+      return index;
+    }
+
+    const unsigned shift = static_cast<unsigned>(index / SUB_BUCKETS) - 1;
+    const std::uint64_t sub_bucket = index - shift * SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+  }
+
+  std::array<std::atomic<std::uint64_t>, BUCKETS> counts_;
+  std::atomic<std::uint64_t> max_{ 0 };
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_LATENCY_HISTOGRAM_H__
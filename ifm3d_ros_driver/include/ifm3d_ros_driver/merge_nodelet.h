@@ -0,0 +1,75 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_MERGE_NODELET_H__
+#define __IFM3D_ROS_MERGE_NODELET_H__
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nodelet/nodelet.h>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/Header.h>
+
+#include <ifm3d_ros_driver/message_pool.h>
+
+namespace ifm3d_ros
+{
+/**
+ * Merges the clouds of several heads into a single unorganized cloud. Meant
+ * to be loaded into the nodelet manager of the camera nodelet(s), so that
+ * the clouds are received without serialization or copies. The clouds are
+ * paired by their timestamps, every point is transformed into the common
+ * frame on the way into the merged cloud.
+ */
+class MergeNodelet : public nodelet::Nodelet
+{
+private:
+  //
+  // Nodelet lifecycle functions
+  //
+  void onInit() override;
+
+  //
+  // Subscription callbacks
+  //
+  void CloudCallback(std::size_t input, const sensor_msgs::PointCloud2ConstPtr& cloud);
+
+  //
+  // state
+  //
+  std::vector<std::string> inputs_;
+  std::string frame_id_;
+  double sync_tolerance_secs_;
+  int buffer_pool_depth_;
+
+  //
+  // Per input: the static transform from its frame into the common one and
+  // the latest cloud not merged yet. Guarded by `mutex_`, as the callbacks
+  // of the inputs run concurrently.
+  //
+  std::mutex mutex_;
+  std::vector<std::array<float, 16>> static_transforms_;
+  std::vector<sensor_msgs::PointCloud2ConstPtr> latest_;
+
+  // the set of clouds being merged and the header of the merged cloud,
+  // reused across frames
+  std::vector<sensor_msgs::PointCloud2ConstPtr> merge_set_;
+  std_msgs::Header header_;
+
+  ros::NodeHandle np_;
+  std::vector<ros::Subscriber> cloud_subs_;
+  ros::Publisher cloud_pub_;
+  MessagePool<sensor_msgs::PointCloud2>::Ptr cloud_pool_;
+
+};  // end: class MergeNodelet
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_MERGE_NODELET_H__
@@ -0,0 +1,306 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_MESSAGE_POOL_H__
+#define __IFM3D_ROS_MESSAGE_POOL_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+namespace ifm3d_ros
+{
+namespace detail
+{
+// Capacity of the variable sized payload of a message, for all message types which carry a `data` array.
+template <typename MessageT>
+auto storage_capacity(const MessageT& msg, int) -> decltype(msg.data.capacity())
+{
+  return msg.data.capacity();
+}
+
+template <typename MessageT>
+std::size_t storage_capacity(const MessageT& /*msg*/, long)
+{
+  return 0;
+}
+
+/**
+ * Fixed size free list used for the reference count blocks of the shared pointers handed out by a `MessagePool`.
+ * Without it, every `boost::shared_ptr` with a custom deleter would cost one small heap allocation per frame.
+ */
+class BlockArena
+{
+public:
+  ~BlockArena()
+  {
+    for (auto* block : this->free_)
+    {
+      ::operator delete(block);
+    }
+  }
+
+  std::uint64_t Allocations() const
+  {
+    return this->allocations_.load();
+  }
+
+  void* Allocate(std::size_t size)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      if ((size <= this->block_size_) && !this->free_.empty())
+      {
+        void* block = this->free_.back();
+        this->free_.pop_back();
+        return block;
+      }
+    }
+
+    ++this->allocations_;
+    return ::operator new(size);
+  }
+
+  void Deallocate(void* block, std::size_t size)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      if (this->block_size_ == 0)
+      {
+        this->block_size_ = size;
+      }
+
+      if ((size == this->block_size_) && (this->free_.size() < MAX_FREE_BLOCKS))
+      {
+        this->free_.push_back(block);
+        return;
+      }
+    }
+
+    ::operator delete(block);
+  }
+
+private:
+  static constexpr std::size_t MAX_FREE_BLOCKS = 64;
+
+  std::atomic<std::uint64_t> allocations_{ 0 };
+  std::mutex mutex_;
+  std::size_t block_size_ = 0;
+  std::vector<void*> free_;
+};
+
+// Minimal allocator forwarding to a shared `BlockArena`, usable with the allocator aware `boost::shared_ptr`
+// constructor.
+template <typename T>
+struct BlockAllocator
+{
+  using value_type = T;
+
+  explicit BlockAllocator(std::shared_ptr<BlockArena> arena) : arena(std::move(arena))
+  {
+  }
+
+  template <typename U>
+  BlockAllocator(const BlockAllocator<U>& other) : arena(other.arena)
+  {
+  }
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(this->arena->Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n)
+  {
+    this->arena->Deallocate(p, n * sizeof(T));
+  }
+
+  template <typename U>
+  struct rebind
+  {
+    using other = BlockAllocator<U>;
+  };
+
+  std::shared_ptr<BlockArena> arena;
+};
+
+template <typename T, typename U>
+bool operator==(const BlockAllocator<T>& lhs, const BlockAllocator<U>& rhs)
+{
+  return lhs.arena == rhs.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const BlockAllocator<T>& lhs, const BlockAllocator<U>& rhs)
+{
+  return !(lhs == rhs);
+}
+}  // namespace detail
+
+/**
+ * A pool of recycled ROS messages for a single topic.
+ *
+ * `Acquire()` hands out a message wrapped into a `boost::shared_ptr`, which can be published directly. Once the last
+ * subscriber (or the publisher itself) releases the message, it is returned to the pool together with the capacity of
+ * its `data` array, so that in steady state no heap allocations happen on the per-frame path. Messages which are newly
+ * created because the pool ran dry are presized to the largest payload seen so far.
+ *
+ * Every heap allocation done on behalf of the pool (new messages, growth of the `data` array, reference count blocks)
+ * is counted and can be queried through `Allocations()`.
+ */
+template <typename MessageT>
+class MessagePool : public std::enable_shared_from_this<MessagePool<MessageT>>
+{
+public:
+  using Ptr = std::shared_ptr<MessagePool<MessageT>>;
+
+  static Ptr MakeShared(std::size_t depth)
+  {
+    return Ptr(new MessagePool<MessageT>(depth));
+  }
+
+  boost::shared_ptr<MessageT> Acquire()
+  {
+    MessageT* msg = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      if (!this->free_.empty())
+      {
+        msg = this->free_.back().release();
+        this->free_.pop_back();
+      }
+    }
+
+    if (msg == nullptr)
+    {
+      msg = new MessageT();
+      ++this->allocations_;
+      this->Presize(*msg);
+    }
+
+    std::weak_ptr<MessagePool<MessageT>> weak_pool = this->shared_from_this();
+    const auto capacity = detail::storage_capacity(*msg, 0);
+    return boost::shared_ptr<MessageT>(msg, Deleter{ weak_pool, capacity },
+                                       detail::BlockAllocator<MessageT>(this->arena_));
+  }
+
+  std::uint64_t Allocations() const
+  {
+    return this->allocations_.load() + this->arena_->Allocations();
+  }
+
+  /**
+   * Tops the free list up to `depth` messages presized to the largest payload seen so far, with their storage touched,
+   * i.e. already faulted in. Meant to be called off the per-frame path once the payloads are known, e.g. with the
+   * memory locked, so that the messages handed out later never fault.
+   */
+  void Prefault()
+  {
+    std::size_t missing;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      missing = this->depth_ - this->free_.size();
+    }
+
+    for (std::size_t i = 0; i < missing; ++i)
+    {
+      std::unique_ptr<MessageT> msg(new MessageT());
+      ++this->allocations_;
+      this->Touch(*msg);
+
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      if (this->free_.size() >= this->depth_)
+      {
+        break;
+      }
+      this->free_.push_back(std::move(msg));
+    }
+  }
+
+private:
+  struct Deleter
+  {
+    std::weak_ptr<MessagePool<MessageT>> pool;
+    std::size_t capacity;
+
+    void operator()(MessageT* msg) const
+    {
+      auto p = this->pool.lock();
+      if (p)
+      {
+        p->Release(msg, this->capacity);
+      }
+      else
+      {
+        delete msg;
+      }
+    }
+  };
+
+  explicit MessagePool(std::size_t depth)
+    : depth_(depth), allocations_(0), arena_(std::make_shared<detail::BlockArena>())
+  {
+    this->free_.reserve(depth);
+  }
+
+  template <typename M = MessageT>
+  auto Presize(M& msg) -> decltype(msg.data.reserve(0), void())
+  {
+    msg.data.reserve(this->largest_payload_.load());
+  }
+
+  void Presize(...)
+  {
+  }
+
+  template <typename M = MessageT>
+  auto Touch(M& msg) -> decltype(msg.data.reserve(0), void())
+  {
+    msg.data.resize(this->largest_payload_.load());
+    msg.data.clear();
+  }
+
+  void Touch(...)
+  {
+  }
+
+  void Release(MessageT* msg, std::size_t capacity_at_acquire)
+  {
+    const auto capacity = detail::storage_capacity(*msg, 0);
+    if (capacity > capacity_at_acquire)
+    {
+      ++this->allocations_;
+    }
+
+    auto largest = this->largest_payload_.load();
+    while ((capacity > largest) && !this->largest_payload_.compare_exchange_weak(largest, capacity))
+    {
+    }
+
+    std::unique_ptr<MessageT> owned(msg);
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (this->free_.size() < this->depth_)
+    {
+      this->free_.push_back(std::move(owned));
+    }
+  }
+
+  const std::size_t depth_;
+  std::atomic<std::uint64_t> allocations_;
+  std::atomic<std::size_t> largest_payload_{ 0 };
+  std::shared_ptr<detail::BlockArena> arena_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<MessageT>> free_;
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_MESSAGE_POOL_H__
@@ -0,0 +1,106 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_POINT_CLOUD_KERNELS_H__
+#define __IFM3D_ROS_POINT_CLOUD_KERNELS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ifm3d_ros
+{
+/**
+ * Describes the confidence image used to mask invalid pixels: a pixel is
+ * invalid if any of `invalid_bits` is set in its confidence value. Without
+ * `data`, no pixel is masked.
+ */
+struct Confidence
+{
+  const void* data = nullptr;
+  bool wide = false;  // 16 bit (e.g. O3R) instead of 8 bit confidence values
+  std::uint16_t invalid_bits = 0x1;
+};
+
+/**
+ * Computes the interleaved cartesian coordinates (x, y, z) of `n` pixels from
+ * the rotated unit vectors (interleaved ex, ey, ez), the radial distance and
+ * the translation part of the extrinsic calibration (tx, ty, tz):
+ *
+ *   x = ex * d + tx,  y = ey * d + ty,  z = ez * d + tz
+ *
+ * The points are in the frame the unit vectors and the translation are
+ * expressed in, see `OpticalToCameraFrame()`.
+ *
+ * Without confidence data, pixels without a valid distance (d <= 0) are set to
+ * (0, 0, 0), which is what the camera reports for them as well. With
+ * confidence data, these and the pixels flagged invalid are set to NaN.
+ * Returns the number of NaN points. Uses AVX2/FMA or NEON where available.
+ */
+std::size_t ComputeXYZ(const float* uvec, const float* distance, const float* translation,
+                       const Confidence& confidence, float* xyz, std::size_t n);
+
+/**
+ * Rotates `n` interleaved unit vectors of the optical frame (x right, y down,
+ * z forward), as streamed by the camera, into the frame of its cartesian
+ * image (x forward, y left, z up): (ex, ey, ez) -> (ez, -ex, -ey). Meant to
+ * be done once per head, `ComputeXYZ()` then yields the points of `IMG_CART`.
+ */
+void OpticalToCameraFrame(const float* uvec, float* out, std::size_t n);
+
+/**
+ * Copies `n` interleaved (x, y, z) points, setting the ones flagged invalid
+ * by the confidence data to NaN. Returns the number of NaN points.
+ */
+std::size_t CopyXYZ(const float* src, const Confidence& confidence, float* xyz, std::size_t n);
+
+/**
+ * Stream compaction of `n` interleaved (x, y, z) points: copies the points
+ * which are not NaN to the front of `out` and returns their number. With
+ * `pixel_index`, every point is followed by its index into `xyz` (as a
+ * uint32), i.e. a point takes 16 instead of 12 bytes.
+ *
+ * `out` has to provide room for one float more than the `n` points, as every
+ * point is moved with a single 16 byte store.
+ */
+std::size_t CompactXYZ(const float* xyz, std::size_t n, bool pixel_index, float* out);
+
+/**
+ * An image interleaved into the points by `InterleaveFields()`, `format`
+ * tells the pixel type of `data` and the type it is stored as.
+ */
+struct Channel
+{
+  enum class Format
+  {
+    FLOAT32,
+    UINT16_TO_FLOAT32,
+    UINT8_TO_FLOAT32,
+    UINT16,
+    UINT8_TO_UINT16,
+  };
+
+  const void* data = nullptr;
+  Format format = Format::FLOAT32;
+};
+
+/**
+ * Interleaves `n` (x, y, z) points with one 4 byte field per channel, i.e.
+ * writes points of 12 + 4 * `num_channels` bytes to `out` in a single pass
+ * over the data. 16 bit values are stored in the lower half of their field.
+ */
+void InterleaveFields(const float* xyz, const Channel* channels, std::size_t num_channels, std::size_t n,
+                      std::uint8_t* out);
+
+/**
+ * Transforms `n` points by the affine part of the row-major 4x4 matrix `m`,
+ * i.e. p' = R * p + t. The coordinates are read from the first 12 bytes of
+ * every `point_step` bytes of `src` and written as interleaved (x, y, z) to
+ * `xyz`. NaN points stay NaN.
+ */
+void TransformXYZ(const float* m, const std::uint8_t* src, std::size_t point_step, std::size_t n, float* xyz);
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_POINT_CLOUD_KERNELS_H__
@@ -0,0 +1,49 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_RECONNECT_H__
+#define __IFM3D_ROS_RECONNECT_H__
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+
+namespace ifm3d_ros
+{
+/**
+ * The delays between the attempts of a reconnect: capped exponential
+ * backoff with jitter. The n-th delay is drawn uniformly from
+ * [(1 - jitter) * d, d] with d = min(initial * 2^n, max), so that heads
+ * which lost their connection at the same time (e.g. on a cable blip of the
+ * VPU) do not retry in lockstep. Not thread-safe.
+ */
+class Backoff
+{
+public:
+  Backoff(double initial_secs = 0.05, double max_secs = 0.5, double jitter = 0.5);
+
+  std::chrono::steady_clock::duration Next();
+
+  // starts over with the initial delay
+  void Reset();
+
+private:
+  double initial_;
+  double max_;
+  double jitter_;
+  double current_;
+  std::minstd_rand rng_;
+};
+
+/**
+ * Cheap readiness probe: whether a TCP connection to `host`:`port` is
+ * accepted within `timeout_millis`. The connection is closed right away.
+ */
+bool ProbeTcp(const std::string& host, std::uint16_t port, int timeout_millis);
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_RECONNECT_H__
@@ -0,0 +1,174 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_SPSC_QUEUE_H__
+#define __IFM3D_ROS_SPSC_QUEUE_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace ifm3d_ros
+{
+/**
+ * Bounded, lock-free single-producer / single-consumer ring buffer.
+ *
+ * All slots are allocated up front, pushing and popping only move the items. The consumer may block in `WaitPop()`
+ * until an item arrives, a mutex is only touched by the producer when the consumer is actually sleeping.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(std::size_t capacity) : slots_(std::max<std::size_t>(capacity, 1) + 1)
+  {
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // producer side: returns false (leaving `item` untouched) if the queue is full
+  bool TryPush(T& item)
+  {
+    const auto tail = this->tail_.load(std::memory_order_relaxed);
+    const auto next = this->Next(tail);
+    if (next == this->head_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    this->slots_[tail] = std::move(item);
+    this->tail_.store(next, std::memory_order_seq_cst);
+
+    auto size = this->Size();
+    auto peak = this->peak_.load(std::memory_order_relaxed);
+    while ((size > peak) && !this->peak_.compare_exchange_weak(peak, size, std::memory_order_relaxed))
+    {
+    }
+
+    if (this->waiting_.load(std::memory_order_seq_cst))
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->cv_.notify_one();
+    }
+
+    return true;
+  }
+
+  // consumer side: returns false if the queue is empty
+  bool TryPop(T& item)
+  {
+    const auto head = this->head_.load(std::memory_order_relaxed);
+    if (head == this->tail_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    item = std::move(this->slots_[head]);
+    this->head_.store(this->Next(head), std::memory_order_release);
+    return true;
+  }
+
+  // consumer side: blocks up to `timeout` for an item, returns false on timeout or if the queue was closed
+  template <typename Rep, typename Period>
+  bool WaitPop(T& item, const std::chrono::duration<Rep, Period>& timeout)
+  {
+    if (this->TryPop(item))
+    {
+      return true;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      this->waiting_.store(true, std::memory_order_seq_cst);
+      this->cv_.wait_for(lock, timeout, [this] {
+        return this->closed_ || (this->head_.load(std::memory_order_seq_cst) !=
+                                 this->tail_.load(std::memory_order_seq_cst));
+      });
+      this->waiting_.store(false, std::memory_order_relaxed);
+    }
+
+    return this->TryPop(item);
+  }
+
+  // consumer side: blocks until an item arrives, returns false if the queue was closed
+  bool WaitPop(T& item)
+  {
+    while (!this->TryPop(item))
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      if (this->closed_)
+      {
+        return false;
+      }
+
+      this->waiting_.store(true, std::memory_order_seq_cst);
+      this->cv_.wait(lock, [this] {
+        return this->closed_ || (this->head_.load(std::memory_order_seq_cst) !=
+                                 this->tail_.load(std::memory_order_seq_cst));
+      });
+      this->waiting_.store(false, std::memory_order_relaxed);
+    }
+
+    return true;
+  }
+
+  // wakes up a consumer blocked in `WaitPop()`, e.g. on shutdown
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->closed_ = true;
+    this->cv_.notify_all();
+  }
+
+  std::size_t Size() const
+  {
+    const auto head = this->head_.load(std::memory_order_acquire);
+    const auto tail = this->tail_.load(std::memory_order_acquire);
+    return (tail + this->slots_.size() - head) % this->slots_.size();
+  }
+
+  std::size_t Capacity() const
+  {
+    return this->slots_.size() - 1;
+  }
+
+  // highest occupancy since the last call
+  std::size_t Peak()
+  {
+    return this->peak_.exchange(this->Size(), std::memory_order_relaxed);
+  }
+
+private:
+  std::size_t Next(std::size_t idx) const
+  {
+    return (idx + 1) == this->slots_.size() ? 0 : idx + 1;
+  }
+
+  static constexpr std::size_t CACHE_LINE = 64;
+
+  std::vector<T> slots_;
+
+  // keep the indices of producer and consumer on separate cache lines
+  char pad0_[CACHE_LINE];
+  std::atomic<std::size_t> head_{ 0 };
+  char pad1_[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+  std::atomic<std::size_t> tail_{ 0 };
+  char pad2_[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+
+  std::atomic<std::size_t> peak_{ 0 };
+  std::atomic<bool> waiting_{ false };
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_SPSC_QUEUE_H__
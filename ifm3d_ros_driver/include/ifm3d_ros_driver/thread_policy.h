@@ -0,0 +1,83 @@
+// -*- c++ -*-
+
+// SPDX-License-Identifier: Apache-2.0
+//  Copyright (C) 2021 ifm electronic, gmbh
+
+#ifndef __IFM3D_ROS_THREAD_POLICY_H__
+#define __IFM3D_ROS_THREAD_POLICY_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+namespace ifm3d_ros
+{
+/**
+ * Scheduling of a thread of the driver: its real-time priority and the
+ * CPUs it may run on
+ */
+struct ThreadPolicy
+{
+  int priority = 0;       // SCHED_FIFO priority (1 - 99), 0 keeps the default (SCHED_OTHER)
+  std::vector<int> cpus;  // none: any CPU
+
+  bool IsDefault() const
+  {
+    return (this->priority <= 0) && this->cpus.empty();
+  }
+};
+
+/**
+ * Applies `policy` to the calling thread. Throws `std::runtime_error` if
+ * it can not be applied, e.g. without the permission for real-time
+ * scheduling (`CAP_SYS_NICE` or an `rtprio` limit) or for CPUs which do
+ * not exist. The affinity is applied first, it does not need extra
+ * permissions.
+ */
+void ApplyThreadPolicy(const ThreadPolicy& policy);
+
+// e.g. "SCHED_FIFO 80 on CPUs 2,3", for logging
+std::string Describe(const ThreadPolicy& policy);
+
+/**
+ * Locks all current and future pages of the process into memory
+ * (`mlockall`), i.e. memory once touched is never paged out again. Throws
+ * `std::runtime_error` if not permitted, which needs `CAP_IPC_LOCK` or a
+ * sufficient `memlock` limit.
+ */
+void LockMemory();
+
+// touches the next `bytes` of the calling thread's stack, so that it does not fault later on
+void PrefaultStack(std::size_t bytes = 256 * 1024);
+
+/**
+ * The CPU time and the context switches of a thread. Its usage is sampled
+ * from any thread once the thread itself called `Attach()`.
+ */
+class ThreadUsage
+{
+public:
+  struct Sample
+  {
+    double cpu_secs;
+    std::uint64_t voluntary_switches;
+    std::uint64_t involuntary_switches;  // preemptions
+  };
+
+  void Attach();
+
+  // false if the thread did not attach yet or has exited
+  bool Read(Sample& sample) const;
+
+private:
+  std::atomic<int> tid_{ 0 };
+  std::atomic<clockid_t> clock_{ -1 };  // invalid until attached
+};
+
+}  // namespace ifm3d_ros
+
+#endif  // __IFM3D_ROS_THREAD_POLICY_H__
@@ -0,0 +1,1991 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/camera_head.h>
+#include <ifm3d_ros_driver/conversions.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <image_transport/image_transport.h>
+#include <nodelet/nodelet.h>
+#include <ros/ros.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/UInt64.h>
+
+#include <ifm3d/contrib/nlohmann/json.hpp>
+#include <ifm3d_ros_msgs/ClockStatus.h>
+#include <ifm3d_ros_msgs/DriverStats.h>
+#include <ifm3d_ros_msgs/Extrinsics.h>
+#include <ifm3d_ros_msgs/PipelineStatus.h>
+#include <ifm3d_ros_msgs/SoftOff.h>
+#include <ifm3d_ros_msgs/SoftOn.h>
+#include <ifm3d_ros_msgs/StageLatency.h>
+#include <ifm3d_ros_msgs/Trigger.h>
+#include <ifm3d_ros_msgs/TriggeredFrame.h>
+
+using json = nlohmann::json;
+
+namespace
+{
+// calls `f` and adds its duration to `ns`
+template <typename F>
+auto timed(std::uint64_t& ns, F f) -> decltype(f())
+{
+  const auto start = std::chrono::steady_clock::now();
+  auto result = f();
+  ns += static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+  return result;
+}
+
+ifm3d_ros_msgs::StageLatency stage_latency(const std::string& stage, ifm3d_ros::LatencyHistogram& histogram)
+{
+  const ifm3d_ros::LatencyHistogram::Summary summary = histogram.Drain();
+
+  ifm3d_ros_msgs::StageLatency latency;
+  latency.stage = stage;
+  latency.count = summary.count;
+  latency.p50 = static_cast<double>(summary.p50) * 1e-9;
+  latency.p90 = static_cast<double>(summary.p90) * 1e-9;
+  latency.p99 = static_cast<double>(summary.p99) * 1e-9;
+  latency.max = static_cast<double>(summary.max) * 1e-9;
+  return latency;
+}
+
+// like other ROS tools, we keep our files in $ROS_HOME (~/.ros by default)
+std::string ros_home()
+{
+  const char* ros_home = std::getenv("ROS_HOME");
+  if (ros_home != nullptr)
+  {
+    return ros_home;
+  }
+
+  const char* home = std::getenv("HOME");
+  return (home != nullptr) ? std::string(home) + "/.ros" : std::string();
+}
+
+//
+// The states of a reconnect: waiting for the head's PCIC port to accept
+// connections, restarting the framegrabber only (keeping the XMLRPC
+// client) and reconnecting the XMLRPC client as well
+//
+enum class ReconnectState
+{
+  PROBE,
+  RESTART_STREAM,
+  RECONNECT
+};
+}  // namespace
+
+ifm3d::CameraBase::Ptr ifm3d_ros::CameraControl::Connect(const ifm3d::CameraBase::Ptr& stale)
+{
+  if (this->mock)
+  {
+    throw std::runtime_error("The camera is mocked (`mock_camera`), there is no XMLRPC interface");
+  }
+
+  if (!this->cam || (this->cam == stale))
+  {
+    this->cam.reset();
+    auto cam = ifm3d::CameraBase::MakeShared(this->ip, this->xmlrpc_port);
+
+    // instead of giving the camera a fixed time to settle, make sure it answers
+    cam->DeviceType(false);
+    this->cam = cam;
+  }
+
+  return this->cam;
+}
+
+ifm3d_ros::CameraHead::CameraHead(std::shared_ptr<CameraControl> control, const std::string& port,
+                                  std::uint16_t pcic_port, const std::string& frame_id_base, const std::string& name,
+                                  const ros::NodeHandle& np, const ros::NodeHandle& nh,
+                                  ros::CallbackQueueInterface* service_queue)
+  : name_(name), port_(port), pcic_port_(pcic_port), control_(std::move(control)), np_(np), nh_(nh), service_nh_(nh)
+{
+  this->service_nh_.setCallbackQueue(service_queue);
+  this->it_.reset(new image_transport::ImageTransport(this->nh_));
+
+  //
+  // parse data out of the parameter server
+  //
+  // NOTE: AFAIK, there is no way to get an unsigned int type out of the ROS
+  // parameter server.
+  //
+  int schema_mask;
+  int timeout_millis;
+  double timeout_tolerance_secs;
+  bool assume_sw_triggered;
+  int confidence_invalid_bits;
+  int clock_estimator_window;
+  int frame_drop_window;
+  double diagnostics_freq_tolerance;
+  int diagnostics_window;
+  double diagnostics_min_delay;
+  double diagnostics_max_delay;
+  std::string record_dir;
+  int record_segment_size;
+  std::string uvec_cache_dir;
+  double reconnect_backoff_min_secs;
+  double reconnect_backoff_max_secs;
+  double reconnect_jitter;
+  std::string frame_id;
+
+  this->Param("schema_mask", schema_mask, (int)ifm3d::DEFAULT_SCHEMA_MASK);
+  this->Param("timeout_millis", timeout_millis, 500);
+  this->Param("timeout_tolerance_secs", timeout_tolerance_secs, 5.0);
+  this->Param("assume_sw_triggered", assume_sw_triggered, false);
+  this->Param("soft_on_timeout_millis", this->soft_on_timeout_millis_, 500);
+  this->Param("soft_on_timeout_tolerance_secs", this->soft_on_timeout_tolerance_secs_, 5.0);
+  this->Param("soft_off_timeout_millis", this->soft_off_timeout_millis_, 500);
+  this->Param("soft_off_timeout_tolerance_secs", this->soft_off_timeout_tolerance_secs_, 600.0);
+  this->Param("frame_latency_thresh", this->frame_latency_thresh_, 60.0f);
+  this->Param("estimate_clock_offset", this->estimate_clock_offset_, false);
+  this->Param("clock_estimator_window", clock_estimator_window, 300);
+  this->Param("frame_drop_window", frame_drop_window, 32);
+  this->Param("diagnostics_min_freq", this->diagnostics_min_freq_, 1.0);
+  this->Param("diagnostics_max_freq", this->diagnostics_max_freq_, 60.0);
+  this->Param("diagnostics_freq_tolerance", diagnostics_freq_tolerance, 0.1);
+  this->Param("diagnostics_window", diagnostics_window, 5);
+  this->Param("diagnostics_min_delay", diagnostics_min_delay, -1.0);
+  this->Param("diagnostics_max_delay", diagnostics_max_delay, 5.0);
+  this->Param("buffer_pool_depth", this->buffer_pool_depth_, 4);
+  this->Param("dynamic_schema_mask", this->dynamic_schema_mask_, false);
+  this->Param("schema_mask_debounce_secs", this->schema_mask_debounce_secs_, 1.0);
+  this->Param("pipeline_queue_depth", this->pipeline_queue_depth_, 2);
+  this->Param("pipeline_latest_only", this->pipeline_latest_only_, true);
+  this->Param("compute_cartesian", this->compute_cartesian_, false);
+  this->Param("mask_invalid_points", this->mask_invalid_points_, false);
+  this->Param("confidence_invalid_bits", confidence_invalid_bits, 0x1);
+  this->Param("sparse_cloud_pixel_index", this->sparse_cloud_pixel_index_, false);
+  this->Param("cloud_fields", this->cloud_field_names_, std::vector<std::string>());
+  this->Param("mock_rate", this->mock_rate_, 10.0);
+  this->Param("mock_width", this->mock_width_, 224);
+  this->Param("mock_height", this->mock_height_, 172);
+  this->Param("record_dir", record_dir, std::string());
+  this->Param("record_segment_size", record_segment_size, 256);
+  this->Param("replay_dir", this->replay_dir_, std::string());
+  this->Param("replay_speed", this->replay_speed_, 1.0);
+  this->Param("replay_loop", this->replay_loop_, false);
+  this->Param("trigger_rate", this->trigger_rate_, 0.0);
+  this->Param("trigger_max_pending", this->trigger_max_pending_, 1);
+  this->Param("reconnect_backoff_min_secs", reconnect_backoff_min_secs, 0.05);
+  this->Param("reconnect_backoff_max_secs", reconnect_backoff_max_secs, 0.5);
+  this->Param("reconnect_jitter", reconnect_jitter, 0.5);
+  this->Param("reconnect_probe_timeout_millis", this->reconnect_probe_timeout_millis_, 200);
+  this->Param("reconnect_probe_after_timeouts", this->reconnect_probe_after_timeouts_, 3);
+  this->Param("streaming_priority", this->streaming_policy_.priority, 0);
+  this->Param("streaming_cpus", this->streaming_policy_.cpus, std::vector<int>());
+  this->Param("conversion_priority", this->conversion_policy_.priority, this->streaming_policy_.priority);
+  this->Param("conversion_cpus", this->conversion_policy_.cpus, this->streaming_policy_.cpus);
+  this->Param("lock_memory", this->lock_memory_, false);
+  this->Param("uvec_cache_dir", uvec_cache_dir,
+              ros_home().empty() ? std::string() : ros_home() + "/ifm3d_ros/unit_vectors");
+  NODELET_INFO("%s: pcic port %d", this->port_.c_str(), (int)this->pcic_port_);
+
+  this->timeout_millis_ = timeout_millis;
+  this->timeout_tolerance_secs_ = timeout_tolerance_secs;
+  this->assume_sw_triggered_ = assume_sw_triggered;
+  this->schema_mask_ = static_cast<std::uint16_t>(schema_mask);
+  this->active_mask_ = this->schema_mask_;
+  this->pending_mask_ = this->schema_mask_;
+  this->confidence_invalid_bits_ = static_cast<std::uint16_t>(confidence_invalid_bits);
+  this->clock_ = ClockEstimator(static_cast<std::size_t>(std::max(clock_estimator_window, 2)));
+  this->drops_ = FrameDropDetector(static_cast<std::size_t>(std::max(frame_drop_window, 4)));
+  this->backoff_ = Backoff(reconnect_backoff_min_secs, reconnect_backoff_max_secs, reconnect_jitter);
+  this->uvec_backoff_ = Backoff(reconnect_backoff_min_secs, reconnect_backoff_max_secs, reconnect_jitter);
+
+  // the layout of the cloud is fixed, build its field descriptors once
+  try
+  {
+    this->cloud_fields_ = make_cloud_fields(this->cloud_field_names_);
+  }
+  catch (const std::invalid_argument& ex)
+  {
+    NODELET_ERROR_STREAM(ex.what() << ", publishing x, y, z only");
+    this->cloud_field_names_.clear();
+    this->cloud_fields_ = make_cloud_fields(this->cloud_field_names_);
+  }
+
+  this->cloud_field_images_.resize(this->cloud_field_names_.size());
+  this->cloud_fields_mask_ = 0;
+  for (const auto& name : this->cloud_field_names_)
+  {
+    if ((name == "intensity") || (name == "amplitude"))
+    {
+      this->cloud_fields_mask_ |= ifm3d::IMG_AMP;
+    }
+    else if (name == "distance_noise")
+    {
+      this->cloud_fields_mask_ |= ifm3d::IMG_DIS_NOISE;
+    }
+  }
+
+  //
+  // Every head records into a directory of its own. With the memory locked
+  // (`mlockall(MCL_FUTURE)`), every new segment would be locked and faulted
+  // in completely by the acquisition thread, and mapping it fails beyond the
+  // `memlock` limit, so the two exclude each other.
+  //
+  if (!record_dir.empty() && this->lock_memory_)
+  {
+    NODELET_ERROR("`record_dir` can not be combined with `lock_memory`, not recording");
+  }
+  else if (!record_dir.empty())
+  {
+    try
+    {
+      this->recorder_.reset(new FrameRecorder(record_dir + "/" + this->port_,
+                                              static_cast<std::size_t>(std::max(record_segment_size, 1)) << 20));
+      NODELET_INFO("Recording the raw frames into %s/%s", record_dir.c_str(), this->port_.c_str());
+    }
+    catch (const std::runtime_error& ex)
+    {
+      NODELET_ERROR_STREAM(ex.what() << ", not recording");
+    }
+  }
+
+  // mocked and replayed heads have no configuration to key the cache with
+  if (!uvec_cache_dir.empty() && !this->control_->mock)
+  {
+    this->uvec_cache_.reset(new UnitVectorCache(uvec_cache_dir));
+  }
+
+  NODELET_DEBUG_STREAM("setup ros node parameters finished");
+
+  this->frame_id_ = frame_id_base + "_link";
+  this->optical_frame_id_ = frame_id_base + "_optical_link";
+
+  //-------------------
+  // Published topics
+  //-------------------
+  this->cloud_pub_ = this->nh_.advertise<sensor_msgs::PointCloud2>("cloud", 1);
+  this->cloud_sparse_pub_ = this->nh_.advertise<sensor_msgs::PointCloud2>("cloud_sparse", 1);
+  this->distance_pub_ = this->it_->advertise("distance", 1);
+  this->distance_noise_pub_ = this->it_->advertise("distance_noise", 1);
+  this->amplitude_pub_ = this->it_->advertise("amplitude", 1);
+  this->raw_amplitude_pub_ = this->it_->advertise("raw_amplitude", 1);
+  this->conf_pub_ = this->it_->advertise("confidence", 1);
+  this->gray_image_pub_ = this->it_->advertise("gray_image", 1);
+  this->rgb_image_pub_ = this->nh_.advertise<sensor_msgs::CompressedImage>("rgb_image/compressed", 1);
+
+  // we latch the unit vectors
+  this->uvec_pub_ = this->nh_.advertise<sensor_msgs::Image>("unit_vectors", 1, true);
+
+  this->extrinsics_pub_ = this->nh_.advertise<ifm3d_ros_msgs::Extrinsics>("extrinsics", 1);
+  this->pool_allocations_pub_ = this->nh_.advertise<std_msgs::UInt64>("buffer_pool/allocations", 1);
+  this->pipeline_pub_ = this->nh_.advertise<ifm3d_ros_msgs::PipelineStatus>("pipeline", 1);
+  if (this->estimate_clock_offset_)
+  {
+    this->clock_status_pub_ = this->nh_.advertise<ifm3d_ros_msgs::ClockStatus>("clock_status", 1);
+  }
+  this->stats_pub_ = this->nh_.advertise<ifm3d_ros_msgs::DriverStats>("stats", 1);
+  this->triggered_frames_pub_ = this->nh_.advertise<ifm3d_ros_msgs::TriggeredFrame>("triggered_frames", 10);
+
+  //
+  // Diagnostics, named after the head and published on /diagnostics
+  //
+  this->last_error_code_ = 0;
+  this->diagnosed_frames_ = 0;
+  this->diagnosed_timeouts_ = 0;
+  this->diagnosed_camera_dropped_ = 0;
+  this->updater_.reset(new diagnostic_updater::Updater(this->nh_, this->nh_, this->name_));
+  this->updater_->setHardwareID(this->control_->ip + ":" + std::to_string(this->pcic_port_));
+  this->updater_->add("connection", this, &CameraHead::DiagnoseConnection);
+  this->frames_diagnostic_.reset(new diagnostic_updater::TopicDiagnostic(
+      "frames", *this->updater_,
+      diagnostic_updater::FrequencyStatusParam(&this->diagnostics_min_freq_, &this->diagnostics_max_freq_,
+                                               diagnostics_freq_tolerance, std::max(diagnostics_window, 1)),
+      diagnostic_updater::TimeStampStatusParam(diagnostics_min_delay, diagnostics_max_delay)));
+  NODELET_DEBUG_STREAM("after advertising the publishers");
+
+  //------------------------------------
+  // Message pools for the per-frame data
+  //------------------------------------
+  const auto depth = static_cast<std::size_t>(std::max(this->buffer_pool_depth_, 1));
+  this->cloud_pool_ = ifm3d_ros::MessagePool<sensor_msgs::PointCloud2>::MakeShared(depth);
+  this->cloud_sparse_pool_ = ifm3d_ros::MessagePool<sensor_msgs::PointCloud2>::MakeShared(depth);
+  this->distance_pool_ = ifm3d_ros::MessagePool<sensor_msgs::Image>::MakeShared(depth);
+  this->distance_noise_pool_ = ifm3d_ros::MessagePool<sensor_msgs::Image>::MakeShared(depth);
+  this->amplitude_pool_ = ifm3d_ros::MessagePool<sensor_msgs::Image>::MakeShared(depth);
+  this->raw_amplitude_pool_ = ifm3d_ros::MessagePool<sensor_msgs::Image>::MakeShared(depth);
+  this->conf_pool_ = ifm3d_ros::MessagePool<sensor_msgs::Image>::MakeShared(depth);
+  this->gray_image_pool_ = ifm3d_ros::MessagePool<sensor_msgs::Image>::MakeShared(depth);
+  this->rgb_image_pool_ = ifm3d_ros::MessagePool<sensor_msgs::CompressedImage>::MakeShared(depth);
+  this->extrinsics_pool_ = ifm3d_ros::MessagePool<ifm3d_ros_msgs::Extrinsics>::MakeShared(depth);
+
+  //------------------------------------------------
+  // Queues between the stages of the pipeline
+  //------------------------------------------------
+  const auto queue_depth = static_cast<std::size_t>(std::max(this->pipeline_queue_depth_, 1));
+  this->conversion_queue_.reset(new ifm3d_ros::SpscQueue<Frame>(queue_depth));
+  this->publish_queue_.reset(new ifm3d_ros::SpscQueue<ConvertedFrame>(queue_depth));
+  // one buffer per queue slot plus the ones currently owned by the acquisition and conversion stages
+  this->recycle_queue_.reset(new ifm3d_ros::SpscQueue<ifm3d::StlImageBuffer::Ptr>(queue_depth + 2));
+
+  //---------------------
+  // Advertised Services
+  //---------------------
+  this->trigger_srv_ =
+      this->service_nh_.advertiseService<ifm3d_ros_msgs::Trigger::Request, ifm3d_ros_msgs::Trigger::Response>(
+          "Trigger", std::bind(&CameraHead::Trigger, this, std::placeholders::_1, std::placeholders::_2));
+
+  this->soft_off_srv_ =
+      this->service_nh_.advertiseService<ifm3d_ros_msgs::SoftOff::Request, ifm3d_ros_msgs::SoftOff::Response>(
+          "SoftOff", std::bind(&CameraHead::SoftOff, this, std::placeholders::_1, std::placeholders::_2));
+
+  this->soft_on_srv_ =
+      this->service_nh_.advertiseService<ifm3d_ros_msgs::SoftOn::Request, ifm3d_ros_msgs::SoftOn::Response>(
+          "SoftOn", std::bind(&CameraHead::SoftOn, this, std::placeholders::_1, std::placeholders::_2));
+
+  NODELET_DEBUG_STREAM("after advertise service");
+}
+
+ifm3d_ros::CameraHead::~CameraHead()
+{
+  this->running_ = false;
+  this->WakeAcquisition();
+  this->conversion_queue_->Close();
+  this->publish_queue_->Close();
+
+  if (this->acquisition_thread_.joinable())
+  {
+    this->acquisition_thread_.join();
+  }
+
+  if (this->conversion_thread_.joinable())
+  {
+    this->conversion_thread_.join();
+  }
+
+  if (this->publish_thread_.joinable())
+  {
+    this->publish_thread_.join();
+  }
+
+  if (this->uvec_thread_.joinable())
+  {
+    this->uvec_thread_.join();
+  }
+}
+
+void ifm3d_ros::CameraHead::Start()
+{
+  // with the memory locked, all image buffers are allocated up front instead of on the first frames
+  if (this->lock_memory_)
+  {
+    ifm3d::StlImageBuffer::Ptr buffer = std::make_shared<ifm3d::StlImageBuffer>();
+    while (this->recycle_queue_->TryPush(buffer))
+    {
+      buffer = std::make_shared<ifm3d::StlImageBuffer>();
+    }
+  }
+
+  this->running_ = true;
+  this->acquisition_thread_ = std::thread(&CameraHead::Run, this);
+  this->conversion_thread_ = std::thread(&CameraHead::ConversionLoop, this);
+  this->publish_thread_ = std::thread(&CameraHead::PublishLoop, this);
+
+  this->last_stats_ = ros::WallTime::now();
+  this->stats_timer_ = this->service_nh_.createWallTimer(ros::WallDuration(1.0), &CameraHead::PublishStats, this);
+}
+
+void ifm3d_ros::CameraHead::SetUpThread(const char* stage, const ThreadPolicy& policy, ThreadUsage& usage)
+{
+  usage.Attach();
+  if (this->lock_memory_)
+  {
+    PrefaultStack();
+  }
+
+  // the head keeps streaming if e.g. real-time priorities are not permitted
+  if (!policy.IsDefault())
+  {
+    try
+    {
+      ApplyThreadPolicy(policy);
+      NODELET_INFO("%s thread: %s", stage, Describe(policy).c_str());
+    }
+    catch (const std::runtime_error& ex)
+    {
+      NODELET_WARN_STREAM(stage << " thread: " << ex.what());
+    }
+  }
+}
+
+void ifm3d_ros::CameraHead::PrefaultPools()
+{
+  this->cloud_pool_->Prefault();
+  this->cloud_sparse_pool_->Prefault();
+  this->distance_pool_->Prefault();
+  this->distance_noise_pool_->Prefault();
+  this->amplitude_pool_->Prefault();
+  this->raw_amplitude_pool_->Prefault();
+  this->conf_pool_->Prefault();
+  this->gray_image_pool_->Prefault();
+  this->rgb_image_pool_->Prefault();
+  this->extrinsics_pool_->Prefault();
+}
+
+void ifm3d_ros::CameraHead::PublishStats(const ros::WallTimerEvent& ev)
+{
+  std_msgs::UInt64 msg;
+  msg.data = this->cloud_pool_->Allocations() + this->cloud_sparse_pool_->Allocations() +
+             this->distance_pool_->Allocations() +
+             this->distance_noise_pool_->Allocations() + this->amplitude_pool_->Allocations() +
+             this->raw_amplitude_pool_->Allocations() + this->conf_pool_->Allocations() +
+             this->gray_image_pool_->Allocations() + this->rgb_image_pool_->Allocations() +
+             this->extrinsics_pool_->Allocations();
+  this->pool_allocations_pub_.publish(msg);
+
+  ifm3d_ros_msgs::PipelineStatus status;
+  status.header.stamp = ros::Time::now();
+  status.queue_capacity = this->conversion_queue_->Capacity();
+  status.latest_only = this->pipeline_latest_only_;
+  status.conversion_queue_size = this->conversion_queue_->Size();
+  status.conversion_queue_peak = this->conversion_queue_->Peak();
+  status.publish_queue_size = this->publish_queue_->Size();
+  status.publish_queue_peak = this->publish_queue_->Peak();
+  status.acquired_frames = this->acquired_frames_;
+  status.conversion_dropped_frames = this->conversion_dropped_frames_;
+  status.publish_dropped_frames = this->publish_dropped_frames_;
+  this->pipeline_pub_.publish(status);
+
+  const ros::WallTime now = ros::WallTime::now();
+  ifm3d_ros_msgs::DriverStats stats;
+  stats.header.stamp = status.header.stamp;
+  stats.interval = (now - this->last_stats_).toSec();
+  stats.stages.push_back(stage_latency("wait_for_frame", this->wait_latency_));
+  stats.stages.push_back(stage_latency("extract", this->extract_latency_));
+  stats.stages.push_back(stage_latency("convert", this->convert_latency_));
+  stats.stages.push_back(stage_latency("publish", this->publish_latency_));
+  stats.stages.push_back(stage_latency("total", this->total_latency_));
+  stats.stages.push_back(stage_latency("trigger", this->trigger_latency_));
+  stats.stages.push_back(stage_latency("reconnect", this->reconnect_latency_));
+  stats.frames = this->acquired_frames_;
+  stats.published_frames = this->published_frames_;
+  stats.timeouts = this->timeouts_;
+  stats.reconnects = this->reconnects_;
+  stats.fast_reconnects = this->fast_reconnects_;
+  stats.last_reconnect_time = this->last_reconnect_time_;
+  stats.dropped_frames = this->conversion_dropped_frames_ + this->publish_dropped_frames_;
+  stats.interval_dropped_frames = stats.dropped_frames - this->last_dropped_frames_;
+  stats.camera_dropped_frames = this->camera_dropped_frames_;
+  stats.interval_camera_dropped_frames = stats.camera_dropped_frames - this->last_camera_dropped_frames_;
+  stats.frame_period = this->frame_period_;
+  stats.triggers = this->triggers_;
+  stats.lost_triggers = this->lost_triggers_;
+  this->stats_pub_.publish(stats);
+  this->last_stats_ = now;
+  this->last_dropped_frames_ = stats.dropped_frames;
+  this->last_camera_dropped_frames_ = stats.camera_dropped_frames;
+
+  this->updater_->force_update();
+
+  // every pool has handed out and taken back its messages by now
+  if (this->lock_memory_ && !this->pools_prefaulted_ &&
+      (this->published_frames_ > static_cast<std::uint64_t>(std::max(this->buffer_pool_depth_, 1))))
+  {
+    this->PrefaultPools();
+    this->pools_prefaulted_ = true;
+  }
+
+  if (this->estimate_clock_offset_)
+  {
+    ifm3d_ros_msgs::ClockStatus clock;
+    clock.header.stamp = status.header.stamp;
+    {
+      std::lock_guard<std::mutex> lock(this->clock_mutex_);
+      clock.valid = this->clock_.Samples() > 1;
+      clock.offset = this->clock_.Offset();
+      clock.drift_ppm = this->clock_.DriftPpm();
+      clock.jitter = this->clock_.Jitter();
+      clock.samples = static_cast<std::uint32_t>(this->clock_.Samples());
+      clock.resets = this->clock_.Resets();
+    }
+    this->clock_status_pub_.publish(clock);
+  }
+}
+
+void ifm3d_ros::CameraHead::DiagnoseConnection(diagnostic_updater::DiagnosticStatusWrapper& status)
+{
+  const std::uint64_t frames = this->acquired_frames_;
+  const std::uint64_t timeouts = this->timeouts_;
+  const std::uint64_t camera_dropped = this->camera_dropped_frames_;
+
+  if ((timeouts == this->diagnosed_timeouts_) && (camera_dropped == this->diagnosed_camera_dropped_))
+  {
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Receiving frames");
+  }
+  else if (timeouts == this->diagnosed_timeouts_)
+  {
+    status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Frames lost by the camera or the network");
+  }
+  else if (frames != this->diagnosed_frames_)
+  {
+    status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Timeouts waiting for frames");
+  }
+  else
+  {
+    status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "No frames from the camera");
+  }
+
+  this->diagnosed_frames_ = frames;
+  this->diagnosed_timeouts_ = timeouts;
+  this->diagnosed_camera_dropped_ = camera_dropped;
+
+  status.add("Frames", frames);
+  status.add("Timeouts", timeouts);
+  status.add("Dropped by camera or network", camera_dropped);
+  status.add("Dropped by driver", this->conversion_dropped_frames_ + this->publish_dropped_frames_);
+  status.add("Frame period", this->frame_period_.load());
+  status.add("Restarts", this->reconnects_.load());
+  status.add("Framegrabber-only restarts", this->fast_reconnects_.load());
+  status.add("Last reconnect time", this->last_reconnect_time_.load());
+  status.add("Schema mask", this->active_mask_.load());
+
+  const std::pair<const char*, const ThreadUsage*> threads[] = { { "Acquisition", &this->acquisition_usage_ },
+                                                                 { "Conversion", &this->conversion_usage_ },
+                                                                 { "Publish", &this->publish_usage_ } };
+  for (const auto& thread : threads)
+  {
+    ThreadUsage::Sample usage;
+    if (thread.second->Read(usage))
+    {
+      status.add(std::string(thread.first) + " thread CPU time", usage.cpu_secs);
+      status.add(std::string(thread.first) + " thread involuntary context switches", usage.involuntary_switches);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(this->error_mutex_);
+  status.add("Last error code", this->last_error_code_);
+  status.add("Last error", this->last_error_);
+}
+
+void ifm3d_ros::CameraHead::CountDrops(const Frame& frame)
+{
+  if (frame.stream != this->drops_stream_)
+  {
+    // the gap to the previous frame is a restart, not a drop. Across plain
+    // timeouts the counter or the cadence tells the frames lost meanwhile.
+    this->drops_.Reset();
+    this->drops_stream_ = frame.stream;
+  }
+
+  // the cadence of triggered frames is the one of the triggers
+  const std::int64_t camera_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(frame.buffer->TimeStamp().time_since_epoch()).count();
+  const std::uint64_t lost =
+      this->drops_.Update(frame.sequence, camera_ns, frame.has_count, frame.count, !this->assume_sw_triggered_);
+  if (lost > 0)
+  {
+    NODELET_DEBUG("%llu frame(s) lost before frame %llu", static_cast<unsigned long long>(lost),
+                  static_cast<unsigned long long>(frame.sequence));
+  }
+
+  this->camera_dropped_frames_ = this->drops_.Dropped();
+  this->frame_period_ = this->drops_.Period();
+}
+
+ros::Time ifm3d_ros::CameraHead::Stamp(const Frame& frame)
+{
+  const std::chrono::system_clock::duration camera_time = frame.buffer->TimeStamp().time_since_epoch();
+
+  if (this->estimate_clock_offset_)
+  {
+    const std::int64_t camera_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(camera_time).count();
+
+    std::lock_guard<std::mutex> lock(this->clock_mutex_);
+    ros::Time stamp;
+    stamp.fromNSec(static_cast<std::uint64_t>(this->clock_.Update(camera_ns, frame.received.toNSec())));
+    return stamp;
+  }
+
+  ros::Time stamp(std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1>>>(camera_time).count());
+  if ((frame.received - stamp) > ros::Duration(this->frame_latency_thresh_))
+  {
+    NODELET_INFO_ONCE("Camera's time and client's time are not synced");
+    stamp = frame.received;
+  }
+
+  return stamp;
+}
+
+bool ifm3d_ros::CameraHead::Trigger(ifm3d_ros_msgs::Trigger::Request& req, ifm3d_ros_msgs::Trigger::Response& res)
+{
+  res.status = 0;
+  res.msg = "OK";
+  res.trigger_id = 0;
+
+  if (!this->assume_sw_triggered_)
+  {
+    res.status = -1;
+    res.msg = "The head is not in software triggered mode (assume_sw_triggered)";
+    return true;
+  }
+
+  try
+  {
+    // does not wait for a pending `WaitForFrame`
+    if (!this->IssueTrigger(res.trigger_id))
+    {
+      res.status = -1;
+      res.msg = "The framegrabber is not running or too many triggers are pending (trigger_max_pending)";
+    }
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    res.status = ex.code();
+    res.msg = ex.what();
+  }
+
+  if (res.status != 0)
+  {
+    NODELET_WARN_STREAM("Trigger: " << res.status << " - " << res.msg);
+  }
+
+  return true;
+}
+
+bool ifm3d_ros::CameraHead::IssueTrigger(std::uint64_t& id)
+{
+  auto fg = std::atomic_load(&this->fg_);
+  if (!fg)
+  {
+    return false;
+  }
+
+  // reserve the slot first, the trigger itself goes over the network and
+  // must not stall the matching of the frames
+  {
+    std::lock_guard<std::mutex> lock(this->trigger_mutex_);
+    if (this->pending_triggers_.size() >= static_cast<std::size_t>(std::max(this->trigger_max_pending_, 1)))
+    {
+      return false;
+    }
+
+    id = this->next_trigger_id_++;
+    this->pending_triggers_.push_back(PendingTrigger{ id, std::chrono::steady_clock::now() });
+  }
+
+  try
+  {
+    std::lock_guard<std::mutex> lock(this->sw_trigger_mutex_);
+    fg->SWTrigger();
+  }
+  catch (...)
+  {
+    // the slot may be gone already, e.g. expired or cleared meanwhile
+    std::lock_guard<std::mutex> lock(this->trigger_mutex_);
+    auto trigger = std::find_if(this->pending_triggers_.begin(), this->pending_triggers_.end(),
+                                [id](const PendingTrigger& pending) { return pending.id == id; });
+    if (trigger != this->pending_triggers_.end())
+    {
+      this->pending_triggers_.erase(trigger);
+    }
+    throw;
+  }
+
+  ++this->triggers_;
+  this->trigger_cv_.notify_one();
+  return true;
+}
+
+void ifm3d_ros::CameraHead::AwaitTriggers()
+{
+  std::unique_lock<std::mutex> lock(this->trigger_mutex_);
+  this->trigger_cv_.wait(lock, [this] {
+    return !this->pending_triggers_.empty() || !this->assume_sw_triggered_ || !this->running_;
+  });
+}
+
+void ifm3d_ros::CameraHead::WakeAcquisition()
+{
+  // taking the mutex orders the change of the flags before the waiter's check
+  {
+    std::lock_guard<std::mutex> lock(this->trigger_mutex_);
+  }
+  this->trigger_cv_.notify_all();
+}
+
+long ifm3d_ros::CameraHead::IssueTriggers(bool startup, long timeout_millis)
+{
+  std::uint64_t id;
+  try
+  {
+    if (startup)
+    {
+      // the unit vectors are fetched with a frame of their own
+      std::unique_lock<std::mutex> lock(this->trigger_mutex_);
+      const bool idle = this->pending_triggers_.empty();
+      lock.unlock();
+      if (idle)
+      {
+        this->IssueTrigger(id);
+      }
+      return timeout_millis;
+    }
+
+    if (this->trigger_rate_ < 0.0)
+    {
+      // back to back: the next trigger is issued as soon as a frame arrived,
+      // while the previous ones are still being decoded and published
+      while (this->IssueTrigger(id))
+      {
+      }
+    }
+    else if (this->trigger_rate_ > 0.0)
+    {
+      const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / this->trigger_rate_));
+      auto now = std::chrono::steady_clock::now();
+      if ((now >= this->next_trigger_) && this->IssueTrigger(id))
+      {
+        // skip the slots missed while all triggers were pending
+        this->next_trigger_ = std::max(this->next_trigger_ + period, now);
+      }
+
+      // don't wait for a frame beyond the next slot, unless all triggers are pending
+      std::unique_lock<std::mutex> lock(this->trigger_mutex_);
+      const bool full =
+          this->pending_triggers_.size() >= static_cast<std::size_t>(std::max(this->trigger_max_pending_, 1));
+      lock.unlock();
+      if (!full)
+      {
+        now = std::chrono::steady_clock::now();
+        const long until_next =
+            static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(this->next_trigger_ - now).count());
+        return std::max(std::min(timeout_millis, until_next), 1L);
+      }
+    }
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    NODELET_WARN_STREAM(ex.code() << ": " << ex.what());
+  }
+
+  return timeout_millis;
+}
+
+std::uint64_t ifm3d_ros::CameraHead::MatchTrigger(std::chrono::steady_clock::time_point received,
+                                                   std::chrono::steady_clock::time_point& triggered)
+{
+  // a trigger whose frame never arrived would shift the pairing of all later frames
+  this->ExpireTriggers();
+
+  std::lock_guard<std::mutex> lock(this->trigger_mutex_);
+  if (this->pending_triggers_.empty())
+  {
+    // e.g. the camera is free running after all
+    return 0;
+  }
+
+  if (this->pending_triggers_.front().issued > received)
+  {
+    // e.g. the late frame of an expired trigger, the pending one waits for its own frame
+    NODELET_DEBUG("Frame received before trigger %llu was issued, not matched",
+                  static_cast<unsigned long long>(this->pending_triggers_.front().id));
+    return 0;
+  }
+
+  const PendingTrigger trigger = this->pending_triggers_.front();
+  this->pending_triggers_.pop_front();
+  triggered = trigger.issued;
+  return trigger.id;
+}
+
+void ifm3d_ros::CameraHead::ExpireTriggers()
+{
+  const auto expired = std::chrono::steady_clock::now() - std::chrono::milliseconds(this->timeout_millis_);
+
+  std::lock_guard<std::mutex> lock(this->trigger_mutex_);
+  while (!this->pending_triggers_.empty() && (this->pending_triggers_.front().issued < expired))
+  {
+    NODELET_WARN("No frame for trigger %llu", static_cast<unsigned long long>(this->pending_triggers_.front().id));
+    this->pending_triggers_.pop_front();
+    ++this->lost_triggers_;
+  }
+}
+
+void ifm3d_ros::CameraHead::ClearTriggers()
+{
+  // the triggers of a framegrabber which is gone
+  std::lock_guard<std::mutex> lock(this->trigger_mutex_);
+  this->lost_triggers_ += this->pending_triggers_.size();
+  this->pending_triggers_.clear();
+}
+
+// this is a dummy method for the moment:  the idea of applications is not supported for the O3RCamera
+// we keep this in to possibly keep it comparable / interoperable with the ROS wrappers for other ifm cameras
+bool ifm3d_ros::CameraHead::SoftOff(ifm3d_ros_msgs::SoftOff::Request& req, ifm3d_ros_msgs::SoftOff::Response& res)
+{
+  std::lock_guard<std::mutex> lock(this->control_->mutex);
+  res.status = 0;
+
+  try
+  {
+    // Configure the device from a json string
+    this->control_->Connect()->FromJSONStr("{\"ports\":{\"" + this->port_ + "\": {\"state\": \"IDLE\"}}}");
+
+    // an idle head sends no frames, there is nothing to recover from
+    this->soft_off_ = true;
+    this->assume_sw_triggered_ = false;
+    this->timeout_millis_ = this->soft_off_timeout_millis_;
+    this->timeout_tolerance_secs_ = this->soft_off_timeout_tolerance_secs_;
+    this->WakeAcquisition();
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    res.status = ex.code();
+    res.msg = ex.what();
+    return false;
+  }
+  catch (const std::exception& std_ex)
+  {
+    res.status = -1;
+    res.msg = std_ex.what();
+    return false;
+  }
+
+  NODELET_WARN_STREAM("The concept of applications is not available for the O3R - we use IDLE and RUN states instead");
+  res.msg = "{\"ports\":{\"" + this->port_ + "\": {\"state\": \"IDLE\"}}}";
+
+  return true;
+}
+
+// this is a dummy method for the moment:  the idea of applications is not supported for the O3RCamera
+// we keep this in to possibly keep it comparable / interoperable with the ROS wrappers for other ifm cameras
+bool ifm3d_ros::CameraHead::SoftOn(ifm3d_ros_msgs::SoftOn::Request& req, ifm3d_ros_msgs::SoftOn::Response& res)
+{
+  std::lock_guard<std::mutex> lock(this->control_->mutex);
+  res.status = 0;
+
+  try
+  {
+    // try getting a current configuration as an ifm3d dump
+    // this way a a-priori test before setting the state can be tested
+    // try
+    // {
+    //   json j = this->cam_->ToJSON();
+    // }
+    // catch (const ifm3d::error_t& ex)
+    // {
+    //   NODELET_WARN_STREAM(ex.code());
+    //   NODELET_WARN_STREAM(ex.what());
+    // }
+    // catch (const std::exception& std_ex)
+    //   {
+    //     NODELET_WARN_STREAM(std_ex.what());
+    // }
+
+    // Configure the device from a json string
+    this->control_->Connect()->FromJSONStr("{\"ports\":{\"" + this->port_ + "\": {\"state\": \"RUN\"}}}");
+
+    this->soft_off_ = false;
+    this->assume_sw_triggered_ = false;
+    this->timeout_millis_ = this->soft_on_timeout_millis_;
+    this->timeout_tolerance_secs_ = this->soft_on_timeout_tolerance_secs_;
+    this->WakeAcquisition();
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    res.status = ex.code();
+    res.msg = ex.what();
+    return false;
+  }
+  catch (const std::exception& std_ex)
+  {
+    res.status = -1;
+    res.msg = std_ex.what();
+    return false;
+  }
+
+  NODELET_WARN_STREAM("The concept of applications is not available for the O3R - we use IDLE and RUN states instead");
+  res.msg = "{\"ports\":{\"" + this->port_ + "\": {\"state\": \"RUN\"}}}";
+
+  return true;
+}
+
+bool ifm3d_ros::CameraHead::InitStructures(std::uint16_t mask, bool reconnect)
+{
+  std::lock_guard<std::mutex> lock(this->control_->mutex);
+  bool retval = false;
+
+  try
+  {
+    NODELET_INFO_STREAM("Running dtors...");
+    this->im_.reset();
+    std::atomic_store(&this->fg_, FrameSource::Ptr());
+
+    if (!this->control_->mock)
+    {
+      NODELET_INFO_STREAM("Initializing camera...");
+      this->cam_ = this->control_->Connect(reconnect ? this->cam_ : nullptr);
+    }
+
+    NODELET_INFO_STREAM("Initializing framegrabber...");
+    std::atomic_store(&this->fg_, this->MakeFrameSource(mask));
+    ++this->stream_;
+    this->ClearTriggers();
+    NODELET_INFO("Nodelet arguments: %d, %d", (int)mask, (int)this->pcic_port_);
+
+    NODELET_INFO_STREAM("Initializing image buffer...");
+    this->im_ = std::make_shared<ifm3d::StlImageBuffer>();
+
+    retval = true;
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    NODELET_WARN_STREAM(ex.code() << ": " << ex.what());
+    this->im_.reset();
+    std::atomic_store(&this->fg_, FrameSource::Ptr());
+    retval = false;
+  }
+  catch (const std::exception& std_ex)
+  {
+    NODELET_WARN_STREAM(std_ex.what());
+    this->im_.reset();
+    std::atomic_store(&this->fg_, FrameSource::Ptr());
+    retval = false;
+  }
+
+  return retval;
+}
+
+// this is the helper function for retrieving complete pcic frames
+bool ifm3d_ros::CameraHead::AcquireFrame(long timeout_millis)
+{
+  bool retval = false;
+  NODELET_DEBUG_STREAM("try receiving data via fg WaitForFrame");
+  try
+  {
+    // `fg_` and `im_` belong to the acquisition loop, no need to lock them
+    const auto start = std::chrono::steady_clock::now();
+    retval = this->fg_->WaitForFrame(this->im_.get(), timeout_millis);
+    if (retval)
+    {
+      this->wait_latency_.Record(start);
+    }
+
+    if (retval && this->recorder_)
+    {
+      try
+      {
+        this->recorder_->Append(this->im_->Bytes(), std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                        std::chrono::system_clock::now().time_since_epoch())
+                                                        .count());
+      }
+      catch (const std::runtime_error& ex)
+      {
+        NODELET_ERROR_STREAM(ex.what() << ", stopped recording after " << this->recorder_->Frames() << " frames");
+        this->recorder_.reset();
+      }
+    }
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    NODELET_WARN_STREAM(ex.code() << ": " << ex.what());
+    retval = false;
+
+    std::lock_guard<std::mutex> lock(this->error_mutex_);
+    this->last_error_code_ = ex.code();
+    this->last_error_ = ex.what();
+  }
+
+  return retval;
+}
+
+bool ifm3d_ros::CameraHead::ResetFrameGrabber(std::uint16_t mask)
+{
+  bool retval = false;
+
+  try
+  {
+    NODELET_INFO("Re-initializing framegrabber with mask: %d", (int)mask);
+    std::atomic_store(&this->fg_, FrameSource::Ptr());
+    std::atomic_store(&this->fg_, this->MakeFrameSource(mask));
+    ++this->stream_;
+    this->ClearTriggers();
+    retval = true;
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    NODELET_WARN_STREAM(ex.code() << ": " << ex.what());
+    retval = false;
+  }
+  catch (const std::exception& std_ex)
+  {
+    NODELET_WARN_STREAM(std_ex.what());
+    retval = false;
+  }
+
+  return retval;
+}
+
+ifm3d_ros::FrameSource::Ptr ifm3d_ros::CameraHead::MakeFrameSource(std::uint16_t mask)
+{
+  // a recording has the images it was recorded with, whatever the mask
+  if (!this->replay_dir_.empty())
+  {
+    if (!this->replay_)
+    {
+      auto replay = std::make_shared<ReplayFrameSource>(this->replay_dir_ + "/" + this->port_, this->replay_speed_,
+                                                        this->replay_loop_);
+      NODELET_INFO("Replaying %zu frames from %s/%s", replay->Frames(), this->replay_dir_.c_str(),
+                   this->port_.c_str());
+      this->replay_ = replay;
+    }
+
+    return this->replay_;
+  }
+
+  if (this->control_->mock)
+  {
+    return std::make_shared<MockFrameSource>(this->StreamedSchemaMask(mask),
+                                             static_cast<std::uint32_t>(std::max(this->mock_width_, 1)),
+                                             static_cast<std::uint32_t>(std::max(this->mock_height_, 1)),
+                                             this->mock_rate_);
+  }
+
+  return std::make_shared<FrameGrabberSource>(this->cam_, this->StreamedSchemaMask(mask), this->pcic_port_);
+}
+
+std::uint16_t ifm3d_ros::CameraHead::StreamedSchemaMask(std::uint16_t mask) const
+{
+  // the images interleaved into the cloud
+  if ((mask & ifm3d::IMG_CART) == ifm3d::IMG_CART)
+  {
+    mask |= this->cloud_fields_mask_;
+  }
+
+  // with `compute_cartesian` the cloud is computed from the distance image
+  if (this->compute_cartesian_ && ((mask & ifm3d::IMG_CART) == ifm3d::IMG_CART))
+  {
+    mask = (mask & ~ifm3d::IMG_CART) | ifm3d::IMG_RDIS;
+  }
+
+  return mask;
+}
+
+std::uint16_t ifm3d_ros::CameraHead::SubscribedSchemaMask()
+{
+  // Confidence image, extrinsics and the 2D data are streamed independently of the mask
+  std::uint16_t mask = 0;
+
+  if ((this->cloud_pub_.getNumSubscribers() > 0) || (this->cloud_sparse_pub_.getNumSubscribers() > 0))
+  {
+    mask |= ifm3d::IMG_CART;
+  }
+  if (this->distance_pub_.getNumSubscribers() > 0)
+  {
+    mask |= ifm3d::IMG_RDIS;
+  }
+  if (this->distance_noise_pub_.getNumSubscribers() > 0)
+  {
+    mask |= ifm3d::IMG_DIS_NOISE;
+  }
+  if (this->amplitude_pub_.getNumSubscribers() > 0)
+  {
+    mask |= ifm3d::IMG_AMP;
+  }
+  if (this->raw_amplitude_pub_.getNumSubscribers() > 0)
+  {
+    mask |= ifm3d::IMG_RAMP;
+  }
+  if (this->gray_image_pub_.getNumSubscribers() > 0)
+  {
+    mask |= ifm3d::IMG_GRAY;
+  }
+
+  // never stream more than the user asked for
+  return mask & this->schema_mask_;
+}
+
+void ifm3d_ros::CameraHead::UpdateSchemaMask()
+{
+  const std::uint16_t mask = this->SubscribedSchemaMask();
+  const ros::WallTime now = ros::WallTime::now();
+
+  if (mask != this->pending_mask_)
+  {
+    // (re-)start the debounce period, subscribers tend to come and go in bursts
+    this->pending_mask_ = mask;
+    this->pending_mask_since_ = now;
+    return;
+  }
+
+  if ((mask == this->active_mask_) || ((now - this->pending_mask_since_).toSec() < this->schema_mask_debounce_secs_))
+  {
+    return;
+  }
+
+  NODELET_INFO("Subscriptions changed, schema mask %d -> %d", (int)this->active_mask_, (int)mask);
+  if (this->ResetFrameGrabber(mask))
+  {
+    this->active_mask_ = mask;
+  }
+  else
+  {
+    // retry after another debounce period
+    this->pending_mask_since_ = now;
+  }
+}
+
+bool ifm3d_ros::CameraHead::LookupUnitVectors()
+{
+  // the unit vectors depend on the head's calibration and its configuration, but not on its state
+  std::string key;
+  {
+    std::lock_guard<std::mutex> lock(this->control_->mutex);
+    try
+    {
+      json config = this->control_->Connect()->ToJSON().at("ports").at(this->port_);
+      const std::string serial = config.at("info").at("serialNumber").get<std::string>();
+      config.erase("state");
+      config.erase("data");
+      key = UnitVectorCache::Key(serial, this->port_, config.dump());
+    }
+    catch (const ifm3d::error_t& ex)
+    {
+      NODELET_WARN_STREAM(ex.code() << ": " << ex.what());
+      return false;
+    }
+    catch (const std::exception& std_ex)
+    {
+      NODELET_WARN_STREAM("Could not identify the head, not caching its unit vectors: " << std_ex.what());
+      return false;
+    }
+  }
+
+  std::vector<std::uint8_t> bytes;
+  if (this->uvec_cache_->Load(key, bytes))
+  {
+    try
+    {
+      ifm3d::StlImageBuffer buffer;
+      buffer.SetBytes(bytes, false);
+      ifm3d::Image uvec = buffer.UnitVectors();
+      if (uvec.width() * uvec.height() > 0)
+      {
+        NODELET_INFO("Unit vectors loaded from %s/%s.uvec", this->uvec_cache_->Dir().c_str(), key.c_str());
+        this->PublishUnitVectors(uvec, ros::Time::now());
+        return true;
+      }
+    }
+    catch (const std::exception& std_ex)
+    {
+      NODELET_WARN_STREAM(std_ex.what());
+    }
+
+    NODELET_WARN("Ignoring the invalid unit vectors in %s/%s.uvec", this->uvec_cache_->Dir().c_str(), key.c_str());
+  }
+
+  if (!this->uvec_thread_.joinable())
+  {
+    NODELET_INFO("Unit vectors not cached yet, fetching them on the side");
+    this->uvec_thread_ = std::thread(&CameraHead::FetchUnitVectors, this, key);
+  }
+
+  return true;
+}
+
+void ifm3d_ros::CameraHead::FetchUnitVectors(const std::string& key)
+{
+  //
+  // A connection of our own to the head's PCIC port, streaming the unit
+  // vectors only. In software triggered mode there is no extra trigger,
+  // which would also yield a frame on the main stream, the frame of the
+  // next trigger reaches both connections.
+  //
+  std::unique_ptr<FrameGrabberSource> fg;
+  ifm3d::StlImageBuffer buffer;
+  const long timeout_millis = (this->timeout_millis_ > 0) ? this->timeout_millis_.load() : 1000;
+
+  while (ros::ok() && this->running_)
+  {
+    try
+    {
+      if (!fg)
+      {
+        std::lock_guard<std::mutex> lock(this->control_->mutex);
+        fg.reset(new FrameGrabberSource(this->control_->Connect(), ifm3d::IMG_UVEC, this->pcic_port_));
+      }
+
+      if (fg->WaitForFrame(&buffer, timeout_millis))
+      {
+        ifm3d::Image uvec = buffer.UnitVectors();
+        if (uvec.width() * uvec.height() > 0)
+        {
+          this->PublishUnitVectors(uvec, ros::Time::now());
+          break;
+        }
+      }
+
+      continue;
+    }
+    catch (const ifm3d::error_t& ex)
+    {
+      NODELET_WARN_STREAM(ex.code() << ": " << ex.what());
+    }
+    catch (const std::exception& std_ex)
+    {
+      NODELET_WARN_STREAM(std_ex.what());
+    }
+
+    NODELET_WARN("Could not fetch the unit vectors, retrying");
+    fg.reset();
+    this->WaitBackoff(this->uvec_backoff_);
+  }
+
+  if (!std::atomic_load(&this->uvec_))
+  {
+    return;
+  }
+
+  try
+  {
+    this->uvec_cache_->Store(key, buffer.Bytes());
+    NODELET_INFO("Unit vectors cached in %s/%s.uvec", this->uvec_cache_->Dir().c_str(), key.c_str());
+  }
+  catch (const std::runtime_error& ex)
+  {
+    NODELET_WARN_STREAM(ex.what() << ", not caching the unit vectors");
+  }
+}
+
+void ifm3d_ros::CameraHead::PublishUnitVectors(const ifm3d::Image& uvec, const ros::Time& stamp)
+{
+  std_msgs::Header optical_head = std_msgs::Header();
+  optical_head.stamp = stamp;
+  optical_head.frame_id = this->optical_frame_id_;
+
+  // keep the unit vectors around for computing the cloud on our own,
+  // rotated into the frame of the camera's cartesian image once
+  ifm3d::Image image = uvec;
+  sensor_msgs::ImageConstPtr uvec_msg = ifm3d_to_ros_image(image, optical_head, getName());
+  NODELET_INFO_STREAM("uvec image size: " << uvec_msg->height * uvec_msg->width);
+  std::shared_ptr<const std::vector<float>> cloud_uvec =
+      std::make_shared<std::vector<float>>(camera_frame_unit_vectors(image, getName()));
+  std::atomic_store(&this->uvec_, cloud_uvec);
+  this->uvec_pub_.publish(uvec_msg);
+}
+
+bool ifm3d_ros::CameraHead::Reconnect(std::uint16_t mask)
+{
+  //
+  // Probe first, so that no attempt is wasted on a head which is not back
+  // yet. Restarting the framegrabber is enough if only the data connection
+  // broke, but if that did not bring the frames back last time, the XMLRPC
+  // client is reconnected as well. Mocked heads have nothing to probe.
+  //
+  const bool mocked = this->control_->mock;
+  const bool try_fast = !this->restarted_fast_ && this->cam_;
+  ReconnectState state = mocked ? ReconnectState::RECONNECT : ReconnectState::PROBE;
+
+  while (ros::ok() && this->running_)
+  {
+    switch (state)
+    {
+      case ReconnectState::PROBE:
+        if (ProbeTcp(this->control_->ip, this->pcic_port_, this->reconnect_probe_timeout_millis_))
+        {
+          state = try_fast ? ReconnectState::RESTART_STREAM : ReconnectState::RECONNECT;
+          continue;
+        }
+
+        NODELET_DEBUG("pcic port %d not reachable", (int)this->pcic_port_);
+        break;
+
+      case ReconnectState::RESTART_STREAM:
+        if (this->ResetFrameGrabber(mask))
+        {
+          this->restarted_fast_ = true;
+          ++this->fast_reconnects_;
+          return true;
+        }
+
+        state = ReconnectState::RECONNECT;
+        continue;
+
+      case ReconnectState::RECONNECT:
+        if ((mocked || ProbeTcp(this->control_->ip, this->control_->xmlrpc_port,
+                                this->reconnect_probe_timeout_millis_)) &&
+            this->InitStructures(mask, true))
+        {
+          // from now on, waiting for the frames is up to `timeout_tolerance_secs` again
+          this->restarted_fast_ = false;
+          this->link_lost_ = false;
+          return true;
+        }
+
+        NODELET_WARN_STREAM("Could not re-initialize pixel stream!");
+        state = mocked ? ReconnectState::RECONNECT : ReconnectState::PROBE;
+        break;
+    }
+
+    this->WaitBackoff(this->backoff_);
+  }
+
+  return false;
+}
+
+bool ifm3d_ros::CameraHead::WaitBackoff(Backoff& backoff)
+{
+  // in slices, so that stopping the head is not delayed
+  const auto until = std::chrono::steady_clock::now() + backoff.Next();
+  while (ros::ok() && this->running_ && (std::chrono::steady_clock::now() < until))
+  {
+    std::this_thread::sleep_for(
+        std::min<std::chrono::steady_clock::duration>(until - std::chrono::steady_clock::now(),
+                                                      std::chrono::milliseconds(100)));
+  }
+
+  return this->running_;
+}
+
+void ifm3d_ros::CameraHead::Run()
+{
+  NODELET_DEBUG_STREAM("in Run");
+
+  this->SetUpThread("Acquisition", this->streaming_policy_, this->acquisition_usage_);
+
+  // We need to account for the case of when the nodelet is being started prior
+  // to the camera being plugged in.
+  //
+  // With the unit vector cache, the stream starts with the user's schema
+  // mask, the unit vectors are either cached or fetched on the side.
+  // Otherwise the stream fetches them first and is restarted afterwards.
+  bool got_uvec = false;
+  while (ros::ok() && this->running_)
+  {
+    got_uvec = this->uvec_cache_ && this->LookupUnitVectors();
+    if (got_uvec && this->dynamic_schema_mask_)
+    {
+      this->active_mask_ = this->SubscribedSchemaMask();
+      this->pending_mask_ = this->active_mask_;
+    }
+
+    if (this->InitStructures(got_uvec ? this->active_mask_.load() : ifm3d::IMG_UVEC, false))
+    {
+      break;
+    }
+
+    NODELET_WARN_STREAM("Could not initialize pixel stream!");
+    this->WaitBackoff(this->backoff_);
+  }
+  this->backoff_.Reset();
+
+  // XXX: need to implement a nice strategy for getting the actual times
+  // from the camera which are registered to the frame data in the image
+  // buffer.
+  ros::Time last_frame = ros::Time::now();
+  int silent_timeouts = 0;  // consecutive timeouts while a frame was expected
+  bool soft_off = this->soft_off_;
+
+  while (ros::ok() && this->running_)
+  {
+    // the frames an idle head did not send are not lost
+    if (this->soft_off_ != soft_off)
+    {
+      soft_off = !soft_off;
+      ++this->stream_;
+    }
+
+    if (got_uvec && this->dynamic_schema_mask_)
+    {
+      this->UpdateSchemaMask();
+    }
+
+    // in software triggered mode, trigger before waiting for the frame
+    bool triggered = this->assume_sw_triggered_;
+    if (triggered && got_uvec && (this->trigger_rate_ == 0.0))
+    {
+      // no frame is due before the next `Trigger` call, sleep until then
+      this->AwaitTriggers();
+      triggered = this->assume_sw_triggered_;
+      if (!this->running_)
+      {
+        break;
+      }
+    }
+
+    long timeout_millis = this->timeout_millis_;
+    if (triggered)
+    {
+      timeout_millis = this->IssueTriggers(!got_uvec, timeout_millis);
+    }
+
+    if (!this->AcquireFrame(timeout_millis))
+    {
+      bool expected = !this->soft_off_;
+      if (!triggered)
+      {
+        NODELET_WARN_STREAM("Timeout waiting for camera!");
+        ++this->timeouts_;
+      }
+      else
+      {
+        this->ExpireTriggers();
+
+        // waiting for triggers is not a reason for restarting the framegrabber
+        std::lock_guard<std::mutex> lock(this->trigger_mutex_);
+        expected = !this->pending_triggers_.empty();
+        if (!expected)
+        {
+          last_frame = ros::Time::now();
+        }
+      }
+
+      //
+      // The stream is given up on after `timeout_tolerance_secs` of silence,
+      // or early if the head does not accept connections any more (e.g. its
+      // cable was unplugged), which the probe tells within a fraction of a
+      // second. An idle head (`SoftOff`) keeps accepting them. The probe
+      // blocks this loop, i.e. a single late frame does not trigger it, only
+      // `reconnect_probe_after_timeouts` in a row.
+      //
+      silent_timeouts = expected ? silent_timeouts + 1 : 0;
+      bool lost = (ros::Time::now() - last_frame).toSec() > this->timeout_tolerance_secs_;
+      if (!lost && (silent_timeouts >= std::max(this->reconnect_probe_after_timeouts_, 1)) && !this->control_->mock)
+      {
+        lost = this->link_lost_ ||
+               !ProbeTcp(this->control_->ip, this->pcic_port_, this->reconnect_probe_timeout_millis_);
+        this->link_lost_ = lost;
+      }
+
+      if (lost)
+      {
+        if (!this->recovering_)
+        {
+          this->recovering_ = true;
+          this->recovering_since_ = std::chrono::steady_clock::now();
+          this->backoff_.Reset();
+        }
+        else
+        {
+          // the previous attempt did not bring the frames back
+          this->WaitBackoff(this->backoff_);
+        }
+
+        NODELET_WARN_STREAM("Attempting to restart framegrabber...");
+        if (this->Reconnect(got_uvec ? this->active_mask_.load() : ifm3d::IMG_UVEC))
+        {
+          ++this->reconnects_;
+        }
+        last_frame = ros::Time::now();
+        silent_timeouts = 0;
+      }
+
+      continue;
+    }
+
+    const auto received = std::chrono::steady_clock::now();
+    last_frame = ros::Time::now();
+    silent_timeouts = 0;
+
+    if (this->recovering_)
+    {
+      this->reconnect_latency_.Record(this->recovering_since_);
+      const double secs =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - this->recovering_since_).count();
+      this->last_reconnect_time_ = secs;
+      NODELET_INFO("Stream recovered after %.3f s (%s)", secs,
+                   this->restarted_fast_ ? "framegrabber restarted" : "reconnected");
+      this->recovering_ = false;
+      this->link_lost_ = false;
+      this->restarted_fast_ = false;
+    }
+
+    std::chrono::steady_clock::time_point triggered_at;
+    const std::uint64_t trigger_id = triggered ? this->MatchTrigger(received, triggered_at) : 0;
+
+    // currently the unit vector calculation seems to be missing in the ifm3d state: therefore we don't publish anything
+    // to the uvec pubisher publish unit vectors once on a latched topic, then re-initialize the framegrabber with the
+    // user's requested schema mask
+    if (!got_uvec)
+    {
+      this->PublishUnitVectors(this->im_->UnitVectors(), last_frame);
+      got_uvec = true;
+      if (this->dynamic_schema_mask_)
+      {
+        this->active_mask_ = this->SubscribedSchemaMask();
+        this->pending_mask_ = this->active_mask_;
+      }
+      NODELET_INFO("Got unit vectors, restarting framegrabber with mask: %d", (int)this->active_mask_);
+
+      // the connection to the camera is fine, the framegrabber is all there is to restart
+      this->backoff_.Reset();
+      while (this->running_ && !this->ResetFrameGrabber(this->active_mask_) &&
+             !this->InitStructures(this->active_mask_, true))
+      {
+        NODELET_WARN("Could not re-initialize pixel stream!");
+        this->WaitBackoff(this->backoff_);
+      }
+
+      NODELET_INFO_STREAM("Start streaming data");
+      continue;
+    }
+
+    //
+    // Hand the frame over to the conversion stage and continue with a fresh
+    // buffer, i.e. the buffers are swapped without copying or locking.
+    // Decoding happens in the conversion stage, so that the next
+    // `WaitForFrame` is not delayed by it.
+    //
+    Frame frame;
+    frame.buffer = this->im_;
+    frame.received = last_frame;
+    frame.acquired = std::chrono::steady_clock::now();
+    frame.sequence = ++this->acquired_frames_;
+    frame.stream = this->stream_;
+    frame.has_count = this->fg_->FrameCount(frame.count);
+    frame.trigger_id = trigger_id;
+    frame.triggered = triggered_at;
+    if (this->conversion_queue_->TryPush(frame))
+    {
+      if (!this->recycle_queue_->TryPop(this->im_))
+      {
+        this->im_ = std::make_shared<ifm3d::StlImageBuffer>();
+      }
+    }
+    else
+    {
+      // the conversion stage is busy, drop the frame and reuse its buffer
+      ++this->conversion_dropped_frames_;
+    }
+  }  // end: while (ros::ok()) { ... }
+}  // end: Run()
+
+void ifm3d_ros::CameraHead::Recycle(ifm3d::StlImageBuffer::Ptr& buffer)
+{
+  // a full recycle queue simply frees the buffer
+  this->recycle_queue_->TryPush(buffer);
+  buffer.reset();
+}
+
+void ifm3d_ros::CameraHead::ConversionLoop()
+{
+  this->SetUpThread("Conversion", this->conversion_policy_, this->conversion_usage_);
+
+  Frame frame;
+  Frame newer;
+  ConvertedFrame converted;
+
+  while (ros::ok() && this->running_)
+  {
+    // sleeps until a frame arrives, or the head is stopped
+    if (!this->conversion_queue_->WaitPop(frame))
+    {
+      continue;
+    }
+
+    if (this->pipeline_latest_only_)
+    {
+      while (this->conversion_queue_->TryPop(newer))
+      {
+        this->Recycle(frame.buffer);
+        frame = std::move(newer);
+        ++this->conversion_dropped_frames_;
+      }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    this->extract_ns_ = 0;
+    const bool publish = this->Convert(frame, converted);
+    this->Recycle(frame.buffer);
+
+    if (publish)
+    {
+      const auto elapsed = static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+      this->extract_latency_.Record(this->extract_ns_);
+      this->convert_latency_.Record(elapsed - std::min(elapsed, this->extract_ns_));
+      converted.acquired = frame.acquired;
+    }
+
+    if (publish && !this->publish_queue_->TryPush(converted))
+    {
+      // the publish stage is stalled, drop the messages
+      converted = ConvertedFrame();
+      ++this->publish_dropped_frames_;
+    }
+  }
+}
+
+void ifm3d_ros::CameraHead::PublishLoop()
+{
+  this->SetUpThread("Publish", ThreadPolicy(), this->publish_usage_);
+
+  ConvertedFrame frame;
+  ConvertedFrame newer;
+
+  while (ros::ok() && this->running_)
+  {
+    if (!this->publish_queue_->WaitPop(frame))
+    {
+      continue;
+    }
+
+    if (this->pipeline_latest_only_)
+    {
+      while (this->publish_queue_->TryPop(newer))
+      {
+        frame = std::move(newer);
+        ++this->publish_dropped_frames_;
+      }
+    }
+
+    NODELET_DEBUG_STREAM("start publishing");
+    const auto start = std::chrono::steady_clock::now();
+    if (frame.confidence)
+    {
+      this->conf_pub_.publish(frame.confidence);
+      NODELET_DEBUG_STREAM("after publishing confidence image");
+    }
+
+    if (frame.cloud)
+    {
+      this->cloud_pub_.publish(frame.cloud);
+      NODELET_DEBUG_STREAM("after publishing xyz image");
+    }
+
+    if (frame.cloud_sparse)
+    {
+      this->cloud_sparse_pub_.publish(frame.cloud_sparse);
+      NODELET_DEBUG_STREAM("after publishing sparse cloud");
+    }
+
+    if (frame.distance)
+    {
+      this->distance_pub_.publish(frame.distance);
+      NODELET_DEBUG_STREAM("after publishing distance image");
+    }
+
+    if (frame.distance_noise)
+    {
+      this->distance_noise_pub_.publish(frame.distance_noise);
+      NODELET_DEBUG_STREAM("after publishing distance noise image");
+    }
+
+    if (frame.amplitude)
+    {
+      this->amplitude_pub_.publish(frame.amplitude);
+      NODELET_DEBUG_STREAM("after publishing amplitude image");
+    }
+
+    if (frame.raw_amplitude)
+    {
+      this->raw_amplitude_pub_.publish(frame.raw_amplitude);
+      NODELET_DEBUG_STREAM("Raw amplitude image publisher is a dummy publisher - data will be added soon");
+      NODELET_DEBUG_STREAM("after publishing raw amplitude image");
+    }
+
+    if (frame.gray)
+    {
+      this->gray_image_pub_.publish(frame.gray);
+      NODELET_DEBUG_STREAM("Gray image publisher is a dummy publisher - data will be added soon");
+      NODELET_DEBUG_STREAM("after publishing gray image");
+    }
+
+    if (frame.rgb)
+    {
+      this->rgb_image_pub_.publish(frame.rgb);
+      NODELET_DEBUG_STREAM("after publishing rgb image");
+    }
+
+    if (frame.extrinsics)
+    {
+      this->extrinsics_pub_.publish(frame.extrinsics);
+      NODELET_DEBUG_STREAM("after publishing extrinsics");
+    }
+
+    this->publish_latency_.Record(start);
+    this->total_latency_.Record(frame.acquired);
+    ++this->published_frames_;
+    this->frames_diagnostic_->tick(frame.stamp);
+
+    if (frame.trigger_id != 0)
+    {
+      const auto now = std::chrono::steady_clock::now();
+      this->trigger_latency_.Record(frame.triggered);
+
+      ifm3d_ros_msgs::TriggeredFrame triggered;
+      triggered.header.stamp = frame.stamp;
+      triggered.header.frame_id = this->optical_frame_id_;
+      triggered.trigger_id = frame.trigger_id;
+      triggered.receive_latency = std::chrono::duration<double>(frame.acquired - frame.triggered).count();
+      triggered.publish_latency = std::chrono::duration<double>(now - frame.triggered).count();
+      this->triggered_frames_pub_.publish(triggered);
+    }
+
+    // hand the messages back to their pools as early as possible
+    frame = ConvertedFrame();
+  }
+}
+
+bool ifm3d_ros::CameraHead::Convert(Frame& frame, ConvertedFrame& out)
+{
+  out = ConvertedFrame();
+
+  // stamp every frame, also those nobody listens to, to keep the clock
+  // estimate up to date
+  const ros::Time stamp = this->Stamp(frame);
+  out.stamp = stamp;
+  out.trigger_id = frame.trigger_id;
+  out.triggered = frame.triggered;
+  this->CountDrops(frame);
+
+  //
+  // Only extract and convert the data somebody is actually listening to
+  //
+  const std::uint16_t mask = this->active_mask_;
+  const bool want_conf = this->conf_pub_.getNumSubscribers() > 0;
+  const bool want_cloud =
+      ((mask & ifm3d::IMG_CART) == ifm3d::IMG_CART) && (this->cloud_pub_.getNumSubscribers() > 0);
+  const bool want_cloud_sparse =
+      ((mask & ifm3d::IMG_CART) == ifm3d::IMG_CART) && (this->cloud_sparse_pub_.getNumSubscribers() > 0);
+  const bool want_distance =
+      ((mask & ifm3d::IMG_RDIS) == ifm3d::IMG_RDIS) && (this->distance_pub_.getNumSubscribers() > 0);
+  const bool want_distance_noise = ((mask & ifm3d::IMG_DIS_NOISE) == ifm3d::IMG_DIS_NOISE) &&
+                                   (this->distance_noise_pub_.getNumSubscribers() > 0);
+  const bool want_amplitude =
+      ((mask & ifm3d::IMG_AMP) == ifm3d::IMG_AMP) && (this->amplitude_pub_.getNumSubscribers() > 0);
+  const bool want_raw_amplitude =
+      ((mask & ifm3d::IMG_RAMP) == ifm3d::IMG_RAMP) && (this->raw_amplitude_pub_.getNumSubscribers() > 0);
+  const bool want_gray =
+      ((mask & ifm3d::IMG_GRAY) == ifm3d::IMG_GRAY) && (this->gray_image_pub_.getNumSubscribers() > 0);
+  // The 2D is not yet settable in the schema mask
+  const bool want_rgb = this->rgb_image_pub_.getNumSubscribers() > 0;
+  const bool want_extrinsics = this->extrinsics_pub_.getNumSubscribers() > 0;
+  // the trigger latency is measured for every triggered frame
+  const bool want_trigger = frame.trigger_id != 0;
+
+  if (!(want_conf || want_cloud || want_cloud_sparse || want_distance || want_distance_noise || want_amplitude ||
+        want_raw_amplitude || want_gray || want_rgb || want_extrinsics || want_trigger))
+  {
+    NODELET_DEBUG_STREAM("no subscribers, skipping frame");
+    return false;
+  }
+
+  // The headers are kept across frames, so that their frame ids are not
+  // re-allocated for every frame
+  std_msgs::Header& head = this->head_;
+  std_msgs::Header& optical_head = this->optical_head_;
+  bool retval = true;
+
+  NODELET_DEBUG_STREAM("start getting data");
+  try
+  {
+    NODELET_DEBUG_STREAM("prepare header");
+    head.frame_id = this->frame_id_;
+    head.stamp = stamp;
+    NODELET_DEBUG_STREAM("in header, before setting header to msgs");
+    optical_head.stamp = head.stamp;
+    optical_head.frame_id = this->optical_frame_id_;
+
+    // Confidence image is invariant - no need to check the mask. It is
+    // also needed for masking the invalid points of the clouds.
+    const bool mask_cloud = want_cloud && this->mask_invalid_points_;
+    const bool rich_cloud = !this->cloud_field_names_.empty();
+    ifm3d::Image confidence;
+    if (want_conf || mask_cloud || want_cloud_sparse || (want_cloud && rich_cloud))
+    {
+      confidence = timed(this->extract_ns_, [&] { return frame.buffer->ConfidenceImage(); });
+    }
+
+    if (want_conf)
+    {
+      out.confidence = this->conf_pool_->Acquire();
+      ifm3d_to_ros_image(confidence, optical_head, getName(), *out.confidence);
+    }
+
+    // the organized x/y/z-only cloud
+    const sensor_msgs::PointCloud2* xyz = nullptr;
+    if (want_cloud)
+    {
+      const std::uint16_t invalid_bits = mask_cloud ? this->confidence_invalid_bits_ : 0;
+      out.cloud = this->cloud_pool_->Acquire();
+      if (rich_cloud)
+      {
+        for (std::size_t i = 0; i < this->cloud_field_names_.size(); ++i)
+        {
+          const auto& name = this->cloud_field_names_[i];
+          if (name == "confidence")
+          {
+            this->cloud_field_images_[i] = confidence;
+          }
+          else if (name == "distance_noise")
+          {
+            this->cloud_field_images_[i] =
+                timed(this->extract_ns_, [&] { return frame.buffer->DistanceNoiseImage(); });
+          }
+          else
+          {
+            this->cloud_field_images_[i] = timed(this->extract_ns_, [&] { return frame.buffer->AmplitudeImage(); });
+          }
+        }
+      }
+      else
+      {
+        xyz = out.cloud.get();
+      }
+
+      this->BuildCloud(frame, confidence, invalid_bits, rich_cloud, head, *out.cloud);
+    }
+
+    if (want_cloud_sparse)
+    {
+      // compacted from the organized x/y/z cloud with its invalid points
+      // masked, which the rich cloud is written without
+      if (!mask_cloud || rich_cloud)
+      {
+        this->BuildCloud(frame, confidence, this->confidence_invalid_bits_, false, head, this->xyz_scratch_);
+        xyz = &this->xyz_scratch_;
+      }
+
+      out.cloud_sparse = this->cloud_sparse_pool_->Acquire();
+      ifm3d_to_ros_sparse_cloud(*xyz, this->sparse_cloud_pixel_index_, *out.cloud_sparse);
+    }
+
+    if (want_distance)
+    {
+      out.distance = this->distance_pool_->Acquire();
+      ifm3d::Image image = timed(this->extract_ns_, [&] { return frame.buffer->DistanceImage(); });
+      ifm3d_to_ros_image(image, optical_head, getName(), *out.distance);
+    }
+
+    if (want_distance_noise)
+    {
+      out.distance_noise = this->distance_noise_pool_->Acquire();
+      ifm3d::Image image = timed(this->extract_ns_, [&] { return frame.buffer->DistanceNoiseImage(); });
+      ifm3d_to_ros_image(image, optical_head, getName(), *out.distance_noise);
+    }
+
+    if (want_amplitude)
+    {
+      out.amplitude = this->amplitude_pool_->Acquire();
+      ifm3d::Image image = timed(this->extract_ns_, [&] { return frame.buffer->AmplitudeImage(); });
+      ifm3d_to_ros_image(image, optical_head, getName(), *out.amplitude);
+    }
+
+    if (want_raw_amplitude)
+    {
+      out.raw_amplitude = this->raw_amplitude_pool_->Acquire();
+      ifm3d::Image image = timed(this->extract_ns_, [&] { return frame.buffer->RawAmplitudeImage(); });
+      ifm3d_to_ros_image(image, optical_head, getName(), *out.raw_amplitude);
+    }
+
+    if (want_gray)
+    {
+      out.gray = this->gray_image_pool_->Acquire();
+      ifm3d::Image image = timed(this->extract_ns_, [&] { return frame.buffer->GrayImage(); });
+      ifm3d_to_ros_image(image, optical_head, getName(), *out.gray);
+    }
+
+    if (want_rgb)
+    {
+      ifm3d::Image rgb_img = timed(this->extract_ns_, [&] { return frame.buffer->JPEGImage(); });
+      if (rgb_img.height() * rgb_img.width() > 0)
+      {
+        out.rgb = this->rgb_image_pool_->Acquire();
+        ifm3d_to_ros_compressed_image(rgb_img, optical_head, "jpeg", getName(), *out.rgb);
+      }
+    }
+
+    if (want_extrinsics)
+    {
+      const std::vector<float> extrinsics = timed(this->extract_ns_, [&] { return frame.buffer->Extrinsics(); });
+      out.extrinsics = this->extrinsics_pool_->Acquire();
+      out.extrinsics->header = optical_head;
+      try
+      {
+        out.extrinsics->tx = extrinsics.at(0);
+        out.extrinsics->ty = extrinsics.at(1);
+        out.extrinsics->tz = extrinsics.at(2);
+        out.extrinsics->rot_x = extrinsics.at(3);
+        out.extrinsics->rot_y = extrinsics.at(4);
+        out.extrinsics->rot_z = extrinsics.at(5);
+      }
+      catch (const std::out_of_range& ex)
+      {
+        NODELET_WARN("out-of-range error fetching extrinsics");
+      }
+    }
+  }
+  catch (const ifm3d::error_t& ex)
+  {
+    NODELET_WARN_STREAM(ex.what());
+    retval = false;
+  }
+  catch (const std::exception& std_ex)
+  {
+    NODELET_WARN_STREAM(std_ex.what());
+    retval = false;
+  }
+  NODELET_DEBUG_STREAM("finished getting data");
+
+  return retval;
+}
+
+void ifm3d_ros::CameraHead::BuildCloud(Frame& frame, ifm3d::Image& confidence, std::uint16_t invalid_bits, bool rich,
+                                          const std_msgs::Header& head, sensor_msgs::PointCloud2& cloud)
+{
+  if (this->compute_cartesian_)
+  {
+    ifm3d::Image distance = timed(this->extract_ns_, [&] { return frame.buffer->DistanceImage(); });
+    const std::vector<float> extrinsics = timed(this->extract_ns_, [&] { return frame.buffer->Extrinsics(); });
+    const std::shared_ptr<const std::vector<float>> uvec = std::atomic_load(&this->uvec_);
+    if (!uvec)
+    {
+      // still being fetched
+      NODELET_WARN_THROTTLE(5.0, "No unit vectors yet, can not compute the cloud");
+      cloud.header = head;
+      cloud.height = 0;
+      cloud.width = 0;
+      cloud.point_step = 0;
+      cloud.row_step = 0;
+      cloud.data.clear();
+      return;
+    }
+
+    if (rich)
+    {
+      ifm3d_to_ros_cloud(*uvec, distance, extrinsics, confidence, invalid_bits, this->cloud_fields_,
+                         this->cloud_field_images_, head, getName(), cloud);
+    }
+    else
+    {
+      ifm3d_to_ros_cloud(*uvec, distance, extrinsics, confidence, invalid_bits, head, getName(), cloud);
+    }
+  }
+  else
+  {
+    ifm3d::Image xyz = timed(this->extract_ns_, [&] { return frame.buffer->XYZImage(); });
+    if (rich)
+    {
+      ifm3d_to_ros_cloud(xyz, confidence, invalid_bits, this->cloud_fields_, this->cloud_field_images_, head,
+                         getName(), cloud);
+    }
+    else
+    {
+      ifm3d_to_ros_cloud(xyz, confidence, invalid_bits, head, getName(), cloud);
+    }
+  }
+}
+
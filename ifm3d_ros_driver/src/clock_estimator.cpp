@@ -0,0 +1,171 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/clock_estimator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace
+{
+// consecutive samples off the fit before the window is restarted
+constexpr std::size_t MAX_OUTLIERS = 5;
+
+// minimum time span (seconds) of the window for estimating the drift
+constexpr double MIN_DRIFT_SPAN = 1.0;
+}  // namespace
+
+ifm3d_ros::ClockEstimator::ClockEstimator(std::size_t window, double reset_thresh_secs)
+  : window_(std::max<std::size_t>(window, 2)), reset_thresh_secs_(reset_thresh_secs)
+{
+  this->samples_.reserve(this->window_);
+}
+
+void ifm3d_ros::ClockEstimator::Reset()
+{
+  this->samples_.clear();
+  this->next_ = 0;
+  this->outliers_ = 0;
+  this->intercept_ = 0.0;
+  this->slope_ = 0.0;
+  this->jitter_ = 0.0;
+  this->last_x_ = 0.0;
+  ++this->resets_;
+}
+
+std::int64_t ifm3d_ros::ClockEstimator::Update(std::int64_t camera_ns, std::int64_t host_ns)
+{
+  if (this->samples_.empty())
+  {
+    this->ref_camera_ns_ = camera_ns;
+    this->ref_offset_ns_ = host_ns - camera_ns;
+  }
+
+  const Sample sample{ static_cast<double>(camera_ns - this->ref_camera_ns_) * 1e-9,
+                       static_cast<double>(host_ns - camera_ns - this->ref_offset_ns_) * 1e-9 };
+
+  bool outlier = false;
+  if (!this->samples_.empty() && (std::abs(sample.y - this->Predict(sample.x)) > this->reset_thresh_secs_))
+  {
+    if (++this->outliers_ < MAX_OUTLIERS)
+    {
+      // a latency spike, map the stamp with the current fit
+      outlier = true;
+    }
+    else
+    {
+      // the camera's clock jumped
+      this->Reset();
+      return this->Update(camera_ns, host_ns);
+    }
+  }
+
+  if (!outlier)
+  {
+    this->outliers_ = 0;
+    if (this->samples_.size() < this->window_)
+    {
+      this->samples_.push_back(sample);
+    }
+    else
+    {
+      this->samples_[this->next_] = sample;
+      this->next_ = (this->next_ + 1) % this->window_;
+    }
+
+    this->Fit();
+    this->last_x_ = sample.x;
+  }
+
+  // a frame can not have been captured after it was received, which also
+  // bounds the stamps of a clock jump until it is detected
+  std::int64_t stamp = camera_ns + this->ref_offset_ns_ + std::llround(this->Predict(sample.x) * 1e9);
+  stamp = std::min(stamp, host_ns);
+  if (this->have_stamp_ && (stamp <= this->last_stamp_ns_))
+  {
+    stamp = this->last_stamp_ns_ + 1;
+  }
+
+  this->last_stamp_ns_ = stamp;
+  this->have_stamp_ = true;
+  return stamp;
+}
+
+void ifm3d_ros::ClockEstimator::Fit()
+{
+  const double n = static_cast<double>(this->samples_.size());
+
+  double mean_x = 0.0;
+  double mean_y = 0.0;
+  double min_x = std::numeric_limits<double>::max();
+  double max_x = std::numeric_limits<double>::lowest();
+  for (const auto& s : this->samples_)
+  {
+    mean_x += s.x;
+    mean_y += s.y;
+    min_x = std::min(min_x, s.x);
+    max_x = std::max(max_x, s.x);
+  }
+  mean_x /= n;
+  mean_y /= n;
+
+  double sxx = 0.0;
+  double sxy = 0.0;
+  for (const auto& s : this->samples_)
+  {
+    sxx += (s.x - mean_x) * (s.x - mean_x);
+    sxy += (s.x - mean_x) * (s.y - mean_y);
+  }
+
+  // the drift is not observable over short spans, it is in the order of ppm
+  this->slope_ = ((max_x - min_x) >= MIN_DRIFT_SPAN) ? sxy / sxx : 0.0;
+  this->intercept_ = mean_y - this->slope_ * mean_x;
+
+  // move the line down to the frame with the lowest latency
+  double min_residual = std::numeric_limits<double>::max();
+  double sum_squares = 0.0;
+  for (const auto& s : this->samples_)
+  {
+    const double residual = s.y - this->Predict(s.x);
+    min_residual = std::min(min_residual, residual);
+    sum_squares += residual * residual;
+  }
+
+  this->intercept_ += min_residual;
+  this->jitter_ = std::sqrt(sum_squares / n);
+}
+
+double ifm3d_ros::ClockEstimator::Predict(double x) const
+{
+  return this->intercept_ + this->slope_ * x;
+}
+
+double ifm3d_ros::ClockEstimator::Offset() const
+{
+  return static_cast<double>(this->ref_offset_ns_) * 1e-9 + this->Predict(this->last_x_);
+}
+
+double ifm3d_ros::ClockEstimator::DriftPpm() const
+{
+  return this->slope_ * 1e6;
+}
+
+double ifm3d_ros::ClockEstimator::Jitter() const
+{
+  return this->jitter_;
+}
+
+std::size_t ifm3d_ros::ClockEstimator::Samples() const
+{
+  return this->samples_.size();
+}
+
+std::uint32_t ifm3d_ros::ClockEstimator::Resets() const
+{
+  return this->resets_;
+}
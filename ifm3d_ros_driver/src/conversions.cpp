@@ -0,0 +1,761 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/conversions.h>
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <ros/ros.h>
+#include <sensor_msgs/PointField.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <ifm3d_ros_driver/point_cloud_kernels.h>
+
+namespace
+{
+// A recycled message already carries the field descriptors. With
+// `pixel_index` a uint32 field holding the index of the pixel of a point
+// follows the coordinates.
+void init_xyz_fields(sensor_msgs::PointCloud2& result, bool pixel_index = false)
+{
+  if (result.fields.size() == (pixel_index ? 4 : 3))
+  {
+    return;
+  }
+
+  sensor_msgs::PointField x_field{};
+  x_field.name = "x";
+  x_field.offset = 0;
+  x_field.datatype = sensor_msgs::PointField::FLOAT32;
+  x_field.count = 1;
+
+  sensor_msgs::PointField y_field{};
+  y_field.name = "y";
+  y_field.offset = 4;
+  y_field.datatype = sensor_msgs::PointField::FLOAT32;
+  y_field.count = 1;
+
+  sensor_msgs::PointField z_field{};
+  z_field.name = "z";
+  z_field.offset = 8;
+  z_field.datatype = sensor_msgs::PointField::FLOAT32;
+  z_field.count = 1;
+
+  result.fields = {
+    x_field,
+    y_field,
+    z_field,
+  };
+
+  if (pixel_index)
+  {
+    sensor_msgs::PointField index_field{};
+    index_field.name = "pixel_index";
+    index_field.offset = 12;
+    index_field.datatype = sensor_msgs::PointField::UINT32;
+    index_field.count = 1;
+    result.fields.push_back(index_field);
+  }
+}
+
+// Describes `confidence` for the point cloud kernels, leaves `result` empty
+// (i.e. no masking) if masking is disabled or the image doesn't fit the cloud
+void init_confidence(ifm3d::Image& confidence, std::uint16_t invalid_bits, std::uint32_t width, std::uint32_t height,
+                     const std::string& logger, ifm3d_ros::Confidence& result)
+{
+  result = ifm3d_ros::Confidence();
+  if ((invalid_bits == 0) || (confidence.width() * confidence.height() == 0))
+  {
+    return;
+  }
+
+  const auto format = confidence.dataFormat();
+  if ((confidence.width() != width) || (confidence.height() != height) ||
+      ((format != ifm3d::pixel_format::FORMAT_8U) && (format != ifm3d::pixel_format::FORMAT_16U)))
+  {
+    ROS_WARN_NAMED(logger, "Confidence image (%ux%u, format %ld) doesn't match the point cloud (%ux%u), not masking",
+                   confidence.width(), confidence.height(), static_cast<std::size_t>(format), width, height);
+    return;
+  }
+
+  result.data = confidence.ptr<>(0);
+  result.wide = format == ifm3d::pixel_format::FORMAT_16U;
+  result.invalid_bits = invalid_bits;
+}
+
+// Where the points of a cloud come from: copied from the camera's cartesian
+// image or computed from the unit vectors, masked by `confidence` either way
+struct XYZSource
+{
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  const float* cartesian = nullptr;
+  const float* uvec = nullptr;
+  const float* distance = nullptr;
+  float translation[3] = { 0.0f, 0.0f, 0.0f };
+  ifm3d_ros::Confidence confidence;
+};
+
+// Returns false (after logging why, if it's not just an empty image) if there
+// are no points to take from `image`
+bool init_cartesian_source(ifm3d::Image& image, ifm3d::Image* confidence, std::uint16_t invalid_bits,
+                           const std::string& logger, XYZSource& source)
+{
+  source = XYZSource();
+  source.width = image.width();
+  source.height = image.height();
+
+  if (image.begin<std::uint8_t>() == image.end<std::uint8_t>())
+  {
+    return false;
+  }
+
+  if (image.dataFormat() != ifm3d::pixel_format::FORMAT_32F3 && image.dataFormat() != ifm3d::pixel_format::FORMAT_32F)
+  {
+    ROS_ERROR_NAMED(logger, "Unsupported pixel format %ld for point cloud",
+                    static_cast<std::size_t>(image.dataFormat()));
+    return false;
+  }
+
+  source.cartesian = image.ptr<float>(0);
+  if ((confidence != nullptr) && (image.dataFormat() == ifm3d::pixel_format::FORMAT_32F3))
+  {
+    init_confidence(*confidence, invalid_bits, source.width, source.height, logger, source.confidence);
+  }
+
+  return true;
+}
+
+bool init_uvec_source(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                      ifm3d::Image* confidence, std::uint16_t invalid_bits, const std::string& logger,
+                      XYZSource& source)
+{
+  source = XYZSource();
+  source.width = distance.width();
+  source.height = distance.height();
+
+  if (distance.begin<std::uint8_t>() == distance.end<std::uint8_t>())
+  {
+    return false;
+  }
+
+  if (distance.dataFormat() != ifm3d::pixel_format::FORMAT_32F)
+  {
+    ROS_ERROR_NAMED(logger, "Unsupported pixel format %ld (distance) for point cloud",
+                    static_cast<std::size_t>(distance.dataFormat()));
+    return false;
+  }
+
+  const std::size_t n = static_cast<std::size_t>(source.width) * source.height;
+  if ((uvec.size() != 3 * n) || (extrinsics.size() < 3))
+  {
+    ROS_ERROR_NAMED(logger, "Unit vectors (%zu pixels) or extrinsics don't match the distance image (%ux%u)",
+                    uvec.size() / 3, distance.width(), distance.height());
+    return false;
+  }
+
+  // the translation is in mm of the optical frame, the cloud in m of the camera frame
+  source.uvec = uvec.data();
+  source.distance = distance.ptr<float>(0);
+  source.translation[0] = extrinsics[2] / 1000.0f;
+  source.translation[1] = -extrinsics[0] / 1000.0f;
+  source.translation[2] = -extrinsics[1] / 1000.0f;
+
+  if (confidence != nullptr)
+  {
+    init_confidence(*confidence, invalid_bits, source.width, source.height, logger, source.confidence);
+  }
+
+  return true;
+}
+
+// Writes the `count` points from pixel `begin` on to `xyz`, returns the number of NaN points
+std::size_t fill_xyz(const XYZSource& source, std::size_t begin, std::size_t count, float* xyz)
+{
+  ifm3d_ros::Confidence confidence = source.confidence;
+  if (confidence.data != nullptr)
+  {
+    confidence.data = static_cast<const std::uint8_t*>(confidence.data) + begin * (confidence.wide ? 2 : 1);
+  }
+
+  if (source.cartesian != nullptr)
+  {
+    return ifm3d_ros::CopyXYZ(source.cartesian + 3 * begin, confidence, xyz, count);
+  }
+
+  return ifm3d_ros::ComputeXYZ(source.uvec + 3 * begin, source.distance + begin, source.translation, confidence, xyz,
+                               count);
+}
+
+void xyz_to_cloud(bool valid, const XYZSource& source, const std_msgs::Header& header,
+                  sensor_msgs::PointCloud2& result)
+{
+  result.header = header;
+  result.height = source.height;
+  result.width = source.width;
+  result.is_bigendian = false;
+  result.point_step = 0;
+  result.row_step = 0;
+  result.data.clear();
+
+  if (!valid)
+  {
+    return;
+  }
+
+  init_xyz_fields(result);
+
+  result.point_step = result.fields.size() * sizeof(float);
+  result.row_step = result.point_step * result.width;
+  result.data.resize(result.row_step * result.height);
+
+  const auto invalid = fill_xyz(source, 0, static_cast<std::size_t>(result.width) * result.height,
+                                reinterpret_cast<float*>(result.data.data()));
+  result.is_dense = invalid == 0;
+}
+
+void cartesian_to_cloud(ifm3d::Image& image, ifm3d::Image* confidence, std::uint16_t invalid_bits,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  XYZSource source;
+  const bool valid = init_cartesian_source(image, confidence, invalid_bits, logger, source);
+  xyz_to_cloud(valid, source, header, result);
+}
+
+void uvec_to_cloud(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                   ifm3d::Image* confidence, std::uint16_t invalid_bits, const std_msgs::Header& header,
+                   const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  XYZSource source;
+  const bool valid = init_uvec_source(uvec, distance, extrinsics, confidence, invalid_bits, logger, source);
+  xyz_to_cloud(valid, source, header, result);
+}
+
+bool has_xyz_fields(const sensor_msgs::PointCloud2& cloud)
+{
+  static const char* const names[] = { "x", "y", "z" };
+  if ((cloud.fields.size() < 3) || (cloud.point_step < 3 * sizeof(float)) || cloud.is_bigendian)
+  {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < 3; ++i)
+  {
+    const auto& field = cloud.fields[i];
+    if ((field.name != names[i]) || (field.offset != i * sizeof(float)) ||
+        (field.datatype != sensor_msgs::PointField::FLOAT32) || (field.count != 1))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+// Describes `images` for `InterleaveFields()`, one channel per field after x, y, z
+bool init_channels(const std::vector<sensor_msgs::PointField>& fields, std::vector<ifm3d::Image>& images,
+                   std::uint32_t width, std::uint32_t height, const std::string& logger,
+                   std::array<ifm3d_ros::Channel, 8>& channels)
+{
+  if (images.size() > channels.size())
+  {
+    ROS_ERROR_NAMED(logger, "Too many point cloud fields (%zu)", images.size());
+    return false;
+  }
+
+  using Format = ifm3d_ros::Channel::Format;
+  for (std::size_t c = 0; c < images.size(); ++c)
+  {
+    auto& image = images[c];
+    const auto datatype = fields[c + 3].datatype;
+    const auto format = image.dataFormat();
+    if ((image.width() != width) || (image.height() != height))
+    {
+      ROS_ERROR_NAMED(logger, "Image for point cloud field %s (%ux%u) doesn't match the cloud (%ux%u)",
+                      fields[c + 3].name.c_str(), image.width(), image.height(), width, height);
+      return false;
+    }
+
+    channels[c].data = image.ptr<>(0);
+    if ((datatype == sensor_msgs::PointField::FLOAT32) && (format == ifm3d::pixel_format::FORMAT_32F))
+    {
+      channels[c].format = Format::FLOAT32;
+    }
+    else if ((datatype == sensor_msgs::PointField::FLOAT32) && (format == ifm3d::pixel_format::FORMAT_16U))
+    {
+      channels[c].format = Format::UINT16_TO_FLOAT32;
+    }
+    else if ((datatype == sensor_msgs::PointField::FLOAT32) && (format == ifm3d::pixel_format::FORMAT_8U))
+    {
+      channels[c].format = Format::UINT8_TO_FLOAT32;
+    }
+    else if ((datatype == sensor_msgs::PointField::UINT16) && (format == ifm3d::pixel_format::FORMAT_16U))
+    {
+      channels[c].format = Format::UINT16;
+    }
+    else if ((datatype == sensor_msgs::PointField::UINT16) && (format == ifm3d::pixel_format::FORMAT_8U))
+    {
+      channels[c].format = Format::UINT8_TO_UINT16;
+    }
+    else
+    {
+      ROS_ERROR_NAMED(logger, "Unsupported pixel format %ld for point cloud field %s",
+                      static_cast<std::size_t>(format), fields[c + 3].name.c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// The channel starting at pixel `begin` of `channel`
+ifm3d_ros::Channel channel_at(const ifm3d_ros::Channel& channel, std::size_t begin)
+{
+  using Format = ifm3d_ros::Channel::Format;
+
+  std::size_t pixel_size = 4;
+  if ((channel.format == Format::UINT16_TO_FLOAT32) || (channel.format == Format::UINT16))
+  {
+    pixel_size = 2;
+  }
+  else if ((channel.format == Format::UINT8_TO_FLOAT32) || (channel.format == Format::UINT8_TO_UINT16))
+  {
+    pixel_size = 1;
+  }
+
+  ifm3d_ros::Channel result = channel;
+  result.data = static_cast<const std::uint8_t*>(channel.data) + begin * pixel_size;
+  return result;
+}
+
+// Prepares `result` for the points of the layout `fields`, returns false if `images` don't fit it
+bool init_rich_cloud(std::uint32_t width, std::uint32_t height, const std::vector<sensor_msgs::PointField>& fields,
+                     std::vector<ifm3d::Image>& images, const std::string& logger,
+                     std::array<ifm3d_ros::Channel, 8>& channels, sensor_msgs::PointCloud2& result)
+{
+  result.height = height;
+  result.width = width;
+  result.is_bigendian = false;
+  result.point_step = 0;
+  result.row_step = 0;
+  result.data.clear();
+
+  if ((width * height == 0) || (fields.size() < 3) || (images.size() != fields.size() - 3))
+  {
+    return false;
+  }
+
+  // The cached descriptors are only copied into fresh messages
+  bool same_fields = result.fields.size() == fields.size();
+  for (std::size_t i = 0; same_fields && (i < fields.size()); ++i)
+  {
+    same_fields = result.fields[i].name == fields[i].name;
+  }
+  if (!same_fields)
+  {
+    result.fields = fields;
+  }
+
+  if (!init_channels(fields, images, width, height, logger, channels))
+  {
+    return false;
+  }
+
+  result.point_step = fields.size() * 4;
+  result.row_step = result.point_step * result.width;
+  result.data.resize(result.row_step * result.height);
+  return true;
+}
+
+//
+// The points of a cloud with extra fields are computed (or copied and
+// masked) block by block into a buffer that stays in the L1 cache and are
+// interleaved with the images from there, i.e. the cloud is written once,
+// without an x/y/z cloud in between.
+//
+constexpr std::size_t RICH_CLOUD_BLOCK = 256;
+
+void rich_to_cloud(bool valid, const XYZSource& source, const std::vector<sensor_msgs::PointField>& fields,
+                   std::vector<ifm3d::Image>& images, const std_msgs::Header& header, const std::string& logger,
+                   sensor_msgs::PointCloud2& result)
+{
+  result.header = header;
+  result.is_dense = true;
+
+  std::array<ifm3d_ros::Channel, 8> channels;
+  if (!init_rich_cloud(source.width, source.height, fields, images, logger, channels, result) || !valid)
+  {
+    result.point_step = 0;
+    result.row_step = 0;
+    result.data.clear();
+    return;
+  }
+
+  const std::size_t n = static_cast<std::size_t>(result.width) * result.height;
+  float xyz[3 * RICH_CLOUD_BLOCK];
+  std::array<ifm3d_ros::Channel, 8> block_channels;
+  std::size_t invalid = 0;
+  for (std::size_t begin = 0; begin < n; begin += RICH_CLOUD_BLOCK)
+  {
+    const std::size_t count = (n - begin > RICH_CLOUD_BLOCK) ? RICH_CLOUD_BLOCK : n - begin;
+    invalid += fill_xyz(source, begin, count, xyz);
+    for (std::size_t c = 0; c < images.size(); ++c)
+    {
+      block_channels[c] = channel_at(channels[c], begin);
+    }
+
+    ifm3d_ros::InterleaveFields(xyz, block_channels.data(), images.size(), count,
+                                result.data.data() + begin * result.point_step);
+  }
+
+  result.is_dense = invalid == 0;
+}
+}  // namespace
+
+void ifm3d_to_ros_image(ifm3d::Image& image,  // Need non-const image because image.begin(),
+                                              // image.end() don't have const overloads.
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::Image& result)
+{
+  struct ImageFormatInfo
+  {
+    std::string encoding;
+    std::uint32_t pixel_size;  // bytes, over all channels
+  };
+
+  static constexpr auto max_pixel_format = static_cast<std::size_t>(ifm3d::pixel_format::FORMAT_32F3);
+  static auto image_format_info = [] {
+    auto image_format_info = std::array<ImageFormatInfo, max_pixel_format + 1>{};
+
+    {
+      using namespace ifm3d;
+      using namespace sensor_msgs::image_encodings;
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_8U)] = { TYPE_8UC1, 1 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_8S)] = { TYPE_8SC1, 1 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_16U)] = { TYPE_16UC1, 2 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_16S)] = { TYPE_16SC1, 2 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_32U)] = { "32UC1", 4 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_32S)] = { TYPE_32SC1, 4 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_32F)] = { TYPE_32FC1, 4 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_64U)] = { "64UC1", 8 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_64F)] = { TYPE_64FC1, 8 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_16U2)] = { TYPE_16UC2, 4 };
+      image_format_info[static_cast<std::size_t>(pixel_format::FORMAT_32F3)] = { TYPE_32FC3, 12 };
+    }
+
+    return image_format_info;
+  }();
+
+  const auto format = static_cast<std::size_t>(image.dataFormat());
+
+  // `result` may be a recycled message: every field is (re-)assigned and `data` is only resized, so that its
+  // capacity is kept across frames.
+  result.header = header;
+  result.height = image.height();
+  result.width = image.width();
+  result.is_bigendian = 0;
+  result.encoding.clear();
+  result.step = 0;
+  result.data.clear();
+
+  if (image.begin<std::uint8_t>() == image.end<std::uint8_t>())
+  {
+    return;
+  }
+
+  if (format > max_pixel_format)
+  {
+    ROS_ERROR_NAMED(logger, "Pixel format out of range (%ld > %ld)", format, max_pixel_format);
+    return;
+  }
+
+  // The size of the pixels is taken from the table, as
+  // `sensor_msgs::image_encodings::bitDepth()` is per channel and does not
+  // know the unsigned 32 and 64 bit encodings.
+  result.encoding = image_format_info.at(format).encoding;
+  result.step = result.width * image_format_info.at(format).pixel_size;
+  result.data.assign(image.ptr<>(0), std::next(image.ptr<>(0), result.step * result.height));
+
+  if (result.encoding.empty())
+  {
+    ROS_WARN_NAMED(logger, "Can't handle encoding %ld (32U == %ld, 64U == %ld)", format,
+                   static_cast<std::size_t>(ifm3d::pixel_format::FORMAT_32U),
+                   static_cast<std::size_t>(ifm3d::pixel_format::FORMAT_64U));
+    result.encoding = sensor_msgs::image_encodings::TYPE_8UC1;
+  }
+}
+
+void ifm3d_to_ros_image(ifm3d::Image&& image, const std_msgs::Header& header, const std::string& logger,
+                        sensor_msgs::Image& result)
+{
+  ifm3d_to_ros_image(image, header, logger, result);
+}
+
+sensor_msgs::ImagePtr ifm3d_to_ros_image(ifm3d::Image& image, const std_msgs::Header& header,
+                                         const std::string& logger)
+{
+  // The message is allocated on the heap and published via its shared pointer so that subscribers living in the
+  // same nodelet manager receive it without any serialization or further copies.
+  auto result = boost::make_shared<sensor_msgs::Image>();
+  ifm3d_to_ros_image(image, header, logger, *result);
+  return result;
+}
+
+sensor_msgs::ImagePtr ifm3d_to_ros_image(ifm3d::Image&& image, const std_msgs::Header& header,
+                                         const std::string& logger)
+{
+  return ifm3d_to_ros_image(image, header, logger);
+}
+
+void ifm3d_to_ros_compressed_image(ifm3d::Image& image,  // Need non-const image because image.begin(),
+                                                         // image.end() don't have const overloads.
+                                   const std_msgs::Header& header,
+                                   const std::string& format,  // "jpeg" or "png"
+                                   const std::string& logger, sensor_msgs::CompressedImage& result)
+{
+  result.header = header;
+  result.format = format;
+  result.data.clear();
+
+  {
+    const auto dataFormat = image.dataFormat();
+    if (dataFormat != ifm3d::pixel_format::FORMAT_8S && dataFormat != ifm3d::pixel_format::FORMAT_8U)
+    {
+      ROS_ERROR_NAMED(logger, "Invalid data format for %s data (%ld)", format.c_str(),
+                      static_cast<std::size_t>(dataFormat));
+      return;
+    }
+  }
+
+  result.data.assign(image.ptr<>(0), std::next(image.ptr<>(0), image.width() * image.height()));
+}
+
+sensor_msgs::CompressedImagePtr ifm3d_to_ros_compressed_image(ifm3d::Image& image, const std_msgs::Header& header,
+                                                              const std::string& format, const std::string& logger)
+{
+  auto result = boost::make_shared<sensor_msgs::CompressedImage>();
+  ifm3d_to_ros_compressed_image(image, header, format, logger, *result);
+  return result;
+}
+
+sensor_msgs::CompressedImagePtr ifm3d_to_ros_compressed_image(ifm3d::Image&& image, const std_msgs::Header& header,
+                                                              const std::string& format, const std::string& logger)
+{
+  return ifm3d_to_ros_compressed_image(image, header, format, logger);
+}
+
+void ifm3d_to_ros_cloud(ifm3d::Image& image,  // Need non-const image because image.begin(),
+                                              // image.end() don't have const overloads.
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  cartesian_to_cloud(image, nullptr, 0, header, logger, result);
+}
+
+void ifm3d_to_ros_cloud(ifm3d::Image&& image, const std_msgs::Header& header, const std::string& logger,
+                        sensor_msgs::PointCloud2& result)
+{
+  ifm3d_to_ros_cloud(image, header, logger, result);
+}
+
+sensor_msgs::PointCloud2Ptr ifm3d_to_ros_cloud(ifm3d::Image& image, const std_msgs::Header& header,
+                                               const std::string& logger)
+{
+  auto result = boost::make_shared<sensor_msgs::PointCloud2>();
+  ifm3d_to_ros_cloud(image, header, logger, *result);
+  return result;
+}
+
+sensor_msgs::PointCloud2Ptr ifm3d_to_ros_cloud(ifm3d::Image&& image, const std_msgs::Header& header,
+                                               const std::string& logger)
+{
+  return ifm3d_to_ros_cloud(image, header, logger);
+}
+
+std::vector<float> camera_frame_unit_vectors(ifm3d::Image& uvec, const std::string& logger)
+{
+  std::vector<float> result;
+  if (uvec.dataFormat() != ifm3d::pixel_format::FORMAT_32F3)
+  {
+    ROS_ERROR_NAMED(logger, "Unsupported pixel format %ld for unit vectors",
+                    static_cast<std::size_t>(uvec.dataFormat()));
+    return result;
+  }
+
+  const std::size_t n = static_cast<std::size_t>(uvec.width()) * uvec.height();
+  result.resize(3 * n);
+  ifm3d_ros::OpticalToCameraFrame(uvec.ptr<float>(0), result.data(), n);
+  return result;
+}
+
+void ifm3d_to_ros_cloud(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  uvec_to_cloud(uvec, distance, extrinsics, nullptr, 0, header, logger, result);
+}
+
+void ifm3d_to_ros_cloud(ifm3d::Image& image, ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  cartesian_to_cloud(image, &confidence, invalid_bits, header, logger, result);
+}
+
+void ifm3d_to_ros_cloud(ifm3d::Image&& image, ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  ifm3d_to_ros_cloud(image, confidence, invalid_bits, header, logger, result);
+}
+
+void ifm3d_to_ros_cloud(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                        ifm3d::Image& confidence, std::uint16_t invalid_bits, const std_msgs::Header& header,
+                        const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  uvec_to_cloud(uvec, distance, extrinsics, &confidence, invalid_bits, header, logger, result);
+}
+
+void ifm3d_to_ros_sparse_cloud(const sensor_msgs::PointCloud2& organized, bool pixel_index,
+                               sensor_msgs::PointCloud2& result)
+{
+  result.header = organized.header;
+  result.height = 1;
+  result.width = 0;
+  result.is_bigendian = false;
+  result.is_dense = true;
+  init_xyz_fields(result, pixel_index);
+  result.point_step = result.fields.size() * sizeof(float);
+  result.row_step = 0;
+
+  const std::size_t n = organized.width * organized.height;
+  if ((organized.point_step != 3 * sizeof(float)) || (organized.data.size() < n * organized.point_step))
+  {
+    result.data.clear();
+    return;
+  }
+
+  // the compaction kernel needs room for one more float
+  result.data.resize(n * result.point_step + sizeof(float));
+  const auto count = ifm3d_ros::CompactXYZ(reinterpret_cast<const float*>(organized.data.data()), n, pixel_index,
+                                           reinterpret_cast<float*>(result.data.data()));
+
+  result.width = count;
+  result.row_step = result.point_step * result.width;
+  result.data.resize(result.row_step);
+}
+
+std::vector<sensor_msgs::PointField> make_cloud_fields(const std::vector<std::string>& extra_fields)
+{
+  sensor_msgs::PointCloud2 cloud;
+  init_xyz_fields(cloud);
+
+  for (const auto& name : extra_fields)
+  {
+    sensor_msgs::PointField field{};
+    field.name = name;
+    field.offset = cloud.fields.size() * 4;
+    field.count = 1;
+
+    if ((name == "intensity") || (name == "amplitude") || (name == "distance_noise"))
+    {
+      field.datatype = sensor_msgs::PointField::FLOAT32;
+    }
+    else if (name == "confidence")
+    {
+      field.datatype = sensor_msgs::PointField::UINT16;
+    }
+    else
+    {
+      throw std::invalid_argument("Unknown point cloud field: " + name);
+    }
+
+    cloud.fields.push_back(field);
+  }
+
+  return cloud.fields;
+}
+
+void ifm3d_to_ros_cloud(const sensor_msgs::PointCloud2& xyz, const std::vector<sensor_msgs::PointField>& fields,
+                        std::vector<ifm3d::Image>& images, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  result.header = xyz.header;
+  result.is_dense = xyz.is_dense;
+
+  std::array<ifm3d_ros::Channel, 8> channels;
+  if ((xyz.point_step != 3 * sizeof(float)) ||
+      !init_rich_cloud(xyz.width, xyz.height, fields, images, logger, channels, result))
+  {
+    result.point_step = 0;
+    result.row_step = 0;
+    result.data.clear();
+    return;
+  }
+
+  ifm3d_ros::InterleaveFields(reinterpret_cast<const float*>(xyz.data.data()), channels.data(), images.size(),
+                              static_cast<std::size_t>(xyz.width) * xyz.height, result.data.data());
+}
+
+void ifm3d_to_ros_cloud(ifm3d::Image& image, ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std::vector<sensor_msgs::PointField>& fields, std::vector<ifm3d::Image>& images,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  XYZSource source;
+  const bool valid = init_cartesian_source(image, &confidence, invalid_bits, logger, source);
+  rich_to_cloud(valid, source, fields, images, header, logger, result);
+}
+
+void ifm3d_to_ros_cloud(const std::vector<float>& uvec, ifm3d::Image& distance, const std::vector<float>& extrinsics,
+                        ifm3d::Image& confidence, std::uint16_t invalid_bits,
+                        const std::vector<sensor_msgs::PointField>& fields, std::vector<ifm3d::Image>& images,
+                        const std_msgs::Header& header, const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  XYZSource source;
+  const bool valid = init_uvec_source(uvec, distance, extrinsics, &confidence, invalid_bits, logger, source);
+  rich_to_cloud(valid, source, fields, images, header, logger, result);
+}
+
+void merge_clouds(const std::vector<sensor_msgs::PointCloud2ConstPtr>& clouds,
+                  const std::vector<std::array<float, 16>>& transforms, const std_msgs::Header& header,
+                  const std::string& logger, sensor_msgs::PointCloud2& result)
+{
+  result.header = header;
+  result.height = 1;
+  result.is_bigendian = false;
+  result.is_dense = true;
+  init_xyz_fields(result);
+  result.point_step = result.fields.size() * sizeof(float);
+
+  std::size_t total = 0;
+  for (const auto& cloud : clouds)
+  {
+    total += cloud->width * cloud->height;
+  }
+
+  // a recycled message keeps its capacity, i.e. this doesn't allocate in steady state
+  result.data.resize(total * result.point_step);
+
+  std::size_t count = 0;
+  for (std::size_t i = 0; (i < clouds.size()) && (i < transforms.size()); ++i)
+  {
+    const auto& cloud = *clouds[i];
+    const std::size_t n = cloud.width * cloud.height;
+    if (!has_xyz_fields(cloud) || (cloud.data.size() < n * cloud.point_step))
+    {
+      ROS_ERROR_NAMED(logger, "Cloud %zu (frame %s) doesn't start with x, y, z, not merging it", i,
+                      cloud.header.frame_id.c_str());
+      continue;
+    }
+
+    ifm3d_ros::TransformXYZ(transforms[i].data(), cloud.data.data(), cloud.point_step, n,
+                            reinterpret_cast<float*>(result.data.data()) + 3 * count);
+    count += n;
+    result.is_dense = result.is_dense && cloud.is_dense;
+  }
+
+  result.width = count;
+  result.row_step = result.point_step * result.width;
+  result.data.resize(result.row_step);
+}
@@ -0,0 +1,104 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/frame_drop_detector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace
+{
+// a gap of more frames is taken for a restart of the camera's stream
+constexpr std::uint64_t MAX_GAP = 10000;
+
+// an interval of more nominal periods is a gap
+constexpr double GAP_FACTOR = 1.5;
+}  // namespace
+
+ifm3d_ros::FrameDropDetector::FrameDropDetector(std::size_t window) : window_(std::max<std::size_t>(window, 4))
+{
+  this->intervals_.reserve(this->window_);
+  this->scratch_.reserve(this->window_);
+}
+
+void ifm3d_ros::FrameDropDetector::Reset()
+{
+  this->intervals_.clear();
+  this->next_ = 0;
+  this->have_last_ = false;
+}
+
+double ifm3d_ros::FrameDropDetector::Period() const
+{
+  if (this->intervals_.size() < this->window_ / 4)
+  {
+    return 0.0;
+  }
+
+  this->scratch_ = this->intervals_;
+  auto median = this->scratch_.begin() + this->scratch_.size() / 2;
+  std::nth_element(this->scratch_.begin(), median, this->scratch_.end());
+  return *median * 1e-9;
+}
+
+std::uint64_t ifm3d_ros::FrameDropDetector::Update(std::uint64_t sequence, std::int64_t camera_ns, bool has_count,
+                                                   std::uint32_t count, bool use_cadence)
+{
+  std::uint64_t lost = 0;
+
+  if (this->have_last_)
+  {
+    // frames received, but dropped by the pipeline before reaching us
+    const std::uint64_t skipped = (sequence > this->last_sequence_) ? sequence - this->last_sequence_ - 1 : 0;
+
+    // frames the camera produced since the previous one, if known
+    std::uint64_t elapsed = 0;
+    const std::int64_t dt = camera_ns - this->last_camera_ns_;
+    if (has_count && this->last_has_count_)
+    {
+      elapsed = static_cast<std::uint32_t>(count - this->last_count_);
+    }
+    else if (use_cadence && (dt > 0))
+    {
+      const double period = this->Period();
+      elapsed = ((period > 0.0) && (static_cast<double>(dt) * 1e-9 > GAP_FACTOR * period)) ?
+                    static_cast<std::uint64_t>(std::llround(static_cast<double>(dt) * 1e-9 / period)) :
+                    skipped + 1;
+    }
+
+    if ((elapsed == 0) || (elapsed > MAX_GAP) || (dt <= 0))
+    {
+      // the counter or the clock restarted, or there is no way to tell
+      this->intervals_.clear();
+      this->next_ = 0;
+    }
+    else
+    {
+      lost = (elapsed - 1 > skipped) ? elapsed - 1 - skipped : 0;
+
+      const double interval = static_cast<double>(dt) / static_cast<double>(elapsed);
+      if (this->intervals_.size() < this->window_)
+      {
+        this->intervals_.push_back(interval);
+      }
+      else
+      {
+        this->intervals_[this->next_] = interval;
+        this->next_ = (this->next_ + 1) % this->window_;
+      }
+    }
+  }
+
+  this->have_last_ = true;
+  this->last_sequence_ = sequence;
+  this->last_camera_ns_ = camera_ns;
+  this->last_has_count_ = has_count;
+  this->last_count_ = count;
+
+  this->dropped_ += lost;
+  return lost;
+}
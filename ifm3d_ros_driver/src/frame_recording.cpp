@@ -0,0 +1,508 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/frame_recording.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr char MAGIC[8] = { 'I', 'F', 'M', '3', 'D', 'R', 'E', 'C' };
+constexpr std::uint32_t VERSION = 1;
+
+constexpr char UVEC_MAGIC[8] = { 'I', 'F', 'M', '3', 'D', 'U', 'V', 'C' };
+constexpr std::uint32_t UVEC_VERSION = 1;
+
+// in the raw PCIC frames: the ticket and "star", followed by the image chunks
+constexpr std::size_t FIRST_CHUNK_OFFSET = 8;
+constexpr std::size_t CHUNK_HEADER_VERSION_OFFSET = 12;
+constexpr std::size_t CHUNK_FRAME_COUNT_OFFSET = 32;
+
+std::runtime_error io_error(const std::string& what, const std::string& path)
+{
+  return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+std::string segment_path(const std::string& dir, std::uint32_t segment)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "segment_%06u.pcic", segment);
+  return dir + "/" + name;
+}
+
+// like `mkdir -p`
+void make_dirs(const std::string& dir)
+{
+  for (std::size_t pos = dir.find('/', 1); pos != std::string::npos; pos = dir.find('/', pos + 1))
+  {
+    if ((::mkdir(dir.substr(0, pos).c_str(), 0755) != 0) && (errno != EEXIST))
+    {
+      throw io_error("Could not create", dir.substr(0, pos));
+    }
+  }
+
+  if ((::mkdir(dir.c_str(), 0755) != 0) && (errno != EEXIST))
+  {
+    throw io_error("Could not create", dir);
+  }
+}
+
+void write_all(int fd, const void* data, std::size_t size, const std::string& path)
+{
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  while (size > 0)
+  {
+    const ssize_t written = ::write(fd, bytes, size);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      throw io_error("Could not write", path);
+    }
+
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+}
+
+std::uint64_t fnv1a(const std::uint8_t* data, std::size_t size)
+{
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::vector<std::uint8_t> read_file(const std::string& path)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw io_error("Could not open", path);
+  }
+
+  std::vector<std::uint8_t> data;
+  std::uint8_t chunk[65536];
+  for (;;)
+  {
+    const ssize_t n = ::read(fd, chunk, sizeof(chunk));
+    if ((n < 0) && (errno == EINTR))
+    {
+      continue;
+    }
+    if (n < 0)
+    {
+      ::close(fd);
+      throw io_error("Could not read", path);
+    }
+    if (n == 0)
+    {
+      break;
+    }
+
+    data.insert(data.end(), chunk, chunk + n);
+  }
+
+  ::close(fd);
+  return data;
+}
+}  // namespace
+
+//-------------------------------
+// FrameRecorder
+//-------------------------------
+ifm3d_ros::FrameRecorder::FrameRecorder(const std::string& dir, std::size_t segment_size)
+  : dir_(dir), segment_size_(std::max<std::size_t>(segment_size, 1 << 20))
+{
+  make_dirs(this->dir_);
+
+  const std::string path = this->dir_ + "/index";
+  this->index_fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (this->index_fd_ < 0)
+  {
+    throw io_error("Could not create the index (is there a recording already?)", path);
+  }
+
+  RecordingIndexHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.reserved = 0;
+  try
+  {
+    write_all(this->index_fd_, &header, sizeof(header), path);
+  }
+  catch (const std::runtime_error&)
+  {
+    ::close(this->index_fd_);
+    throw;
+  }
+}
+
+ifm3d_ros::FrameRecorder::~FrameRecorder()
+{
+  this->CloseSegment();
+  if (this->index_fd_ >= 0)
+  {
+    ::close(this->index_fd_);
+  }
+}
+
+void ifm3d_ros::FrameRecorder::OpenSegment(std::size_t min_size)
+{
+  const std::string path = segment_path(this->dir_, this->segment_id_);
+  this->segment_fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (this->segment_fd_ < 0)
+  {
+    throw io_error("Could not create", path);
+  }
+
+  // allocate the blocks up front, a full disk fails here and not on a page fault of the mapping
+  const std::size_t capacity = std::max(this->segment_size_, min_size);
+  const int err = ::posix_fallocate(this->segment_fd_, 0, static_cast<off_t>(capacity));
+  if (err != 0)
+  {
+    errno = err;
+    const std::runtime_error ex = io_error("Could not allocate", path);
+    ::close(this->segment_fd_);
+    this->segment_fd_ = -1;
+    throw ex;
+  }
+
+  void* data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, this->segment_fd_, 0);
+  if (data == MAP_FAILED)
+  {
+    const std::runtime_error ex = io_error("Could not map", path);
+    ::close(this->segment_fd_);
+    this->segment_fd_ = -1;
+    throw ex;
+  }
+
+  ::madvise(data, capacity, MADV_SEQUENTIAL);
+  this->segment_ = static_cast<std::uint8_t*>(data);
+  this->segment_capacity_ = capacity;
+  this->segment_used_ = 0;
+}
+
+void ifm3d_ros::FrameRecorder::CloseSegment()
+{
+  if (this->segment_fd_ < 0)
+  {
+    return;
+  }
+
+  ::munmap(this->segment_, this->segment_capacity_);
+  // give back the preallocated space which was not used, the index bounds the frames either way
+  const int truncated = ::ftruncate(this->segment_fd_, static_cast<off_t>(this->segment_used_));
+  (void)truncated;
+  ::close(this->segment_fd_);
+
+  this->segment_fd_ = -1;
+  this->segment_ = nullptr;
+  this->segment_capacity_ = 0;
+  this->segment_used_ = 0;
+  ++this->segment_id_;
+}
+
+void ifm3d_ros::FrameRecorder::Append(const std::vector<std::uint8_t>& bytes, std::int64_t stamp_ns)
+{
+  if ((this->segment_fd_ >= 0) && (this->segment_used_ + bytes.size() > this->segment_capacity_))
+  {
+    this->CloseSegment();
+  }
+
+  if (this->segment_fd_ < 0)
+  {
+    this->OpenSegment(bytes.size());
+  }
+
+  std::memcpy(this->segment_ + this->segment_used_, bytes.data(), bytes.size());
+
+  RecordingIndexEntry entry;
+  entry.stamp_ns = stamp_ns;
+  entry.segment = this->segment_id_;
+  entry.size = static_cast<std::uint32_t>(bytes.size());
+  entry.offset = this->segment_used_;
+  write_all(this->index_fd_, &entry, sizeof(entry), this->dir_ + "/index");
+
+  this->segment_used_ += bytes.size();
+  ++this->frames_;
+}
+
+//-------------------------------
+// ReplayFrameSource
+//-------------------------------
+ifm3d_ros::ReplayFrameSource::ReplayFrameSource(const std::string& dir, double speed, bool loop)
+  : speed_(speed), loop_(loop)
+{
+  const std::string index_path = dir + "/index";
+  const std::vector<std::uint8_t> index = read_file(index_path);
+
+  RecordingIndexHeader header;
+  if ((index.size() < sizeof(header)) || (std::memcmp(index.data(), MAGIC, sizeof(MAGIC)) != 0))
+  {
+    throw std::runtime_error("Not a recording: " + index_path);
+  }
+
+  std::memcpy(&header, index.data(), sizeof(header));
+  if (header.version != VERSION)
+  {
+    throw std::runtime_error("Unsupported recording version " + std::to_string(header.version) + ": " + index_path);
+  }
+
+  // a trailing partial entry is left over from a recorder which died while writing it
+  const std::size_t entries = (index.size() - sizeof(header)) / sizeof(RecordingIndexEntry);
+  this->index_.resize(entries);
+  std::memcpy(this->index_.data(), index.data() + sizeof(header), entries * sizeof(RecordingIndexEntry));
+
+  // map the segments, dropping the frames which are not (completely) in them
+  std::uint32_t segments = 0;
+  for (const auto& entry : this->index_)
+  {
+    segments = std::max(segments, entry.segment + 1);
+  }
+
+  for (std::uint32_t i = 0; i < segments; ++i)
+  {
+    const std::string path = segment_path(dir, i);
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if ((fd < 0) || (::fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+      if (fd >= 0)
+      {
+        ::close(fd);
+      }
+      this->segments_.push_back(Segment{ nullptr, 0 });
+      continue;
+    }
+
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+      this->segments_.push_back(Segment{ nullptr, 0 });
+      continue;
+    }
+
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    this->segments_.push_back(Segment{ static_cast<const std::uint8_t*>(data), size });
+  }
+
+  this->index_.erase(std::remove_if(this->index_.begin(), this->index_.end(),
+                                    [this](const RecordingIndexEntry& entry) {
+                                      const Segment& segment = this->segments_[entry.segment];
+                                      return (segment.data == nullptr) || (entry.offset + entry.size > segment.size);
+                                    }),
+                     this->index_.end());
+
+  if (this->index_.empty())
+  {
+    throw std::runtime_error("No frames in the recording " + dir);
+  }
+}
+
+ifm3d_ros::ReplayFrameSource::~ReplayFrameSource()
+{
+  for (const auto& segment : this->segments_)
+  {
+    if (segment.data != nullptr)
+    {
+      ::munmap(const_cast<std::uint8_t*>(segment.data), segment.size);
+    }
+  }
+}
+
+bool ifm3d_ros::ReplayFrameSource::WaitForFrame(ifm3d::StlImageBuffer* buffer, long timeout_millis)
+{
+  const auto timeout = std::chrono::milliseconds(timeout_millis);
+
+  if (this->next_ == this->index_.size())
+  {
+    if (!this->loop_)
+    {
+      std::this_thread::sleep_for(timeout_millis > 0 ? timeout : std::chrono::milliseconds(1000));
+      return false;
+    }
+
+    this->next_ = 0;
+  }
+
+  const RecordingIndexEntry& entry = this->index_[this->next_];
+  const auto now = std::chrono::steady_clock::now();
+  if (this->next_ == 0)
+  {
+    this->start_ = now;
+    this->start_stamp_ns_ = entry.stamp_ns;
+  }
+
+  if (this->speed_ > 0.0)
+  {
+    const std::chrono::duration<double, std::nano> elapsed(
+        static_cast<double>(entry.stamp_ns - this->start_stamp_ns_) / this->speed_);
+    const auto due = this->start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(elapsed);
+    if ((timeout_millis > 0) && (due > now + timeout))
+    {
+      std::this_thread::sleep_for(timeout);
+      return false;
+    }
+
+    std::this_thread::sleep_until(due);
+  }
+
+  const std::uint8_t* data = this->segments_[entry.segment].data + entry.offset;
+
+  // the frame counter of the first chunk, whose header follows the ticket and "star"
+  this->has_count_ = false;
+  std::uint32_t header_version = 0;
+  if (entry.size >= FIRST_CHUNK_OFFSET + CHUNK_FRAME_COUNT_OFFSET + 4)
+  {
+    std::memcpy(&header_version, data + FIRST_CHUNK_OFFSET + CHUNK_HEADER_VERSION_OFFSET, 4);
+    this->has_count_ = header_version >= 2;
+    std::memcpy(&this->count_, data + FIRST_CHUNK_OFFSET + CHUNK_FRAME_COUNT_OFFSET, 4);
+  }
+
+  this->scratch_.assign(data, data + entry.size);
+  buffer->SetBytes(this->scratch_, false);
+  ++this->next_;
+  return true;
+}
+
+void ifm3d_ros::ReplayFrameSource::SWTrigger()
+{
+}
+
+bool ifm3d_ros::ReplayFrameSource::FrameCount(std::uint32_t& count) const
+{
+  count = this->count_;
+  return this->has_count_;
+}
+
+//-------------------------------
+// UnitVectorCache
+//-------------------------------
+ifm3d_ros::UnitVectorCache::UnitVectorCache(const std::string& dir) : dir_(dir)
+{
+}
+
+std::string ifm3d_ros::UnitVectorCache::Key(const std::string& serial, const std::string& port,
+                                            const std::string& config)
+{
+  // the serial number ends up in a file name
+  std::string key;
+  for (const char c : serial + "_" + port)
+  {
+    key += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+  }
+
+  char hash[24];
+  std::snprintf(hash, sizeof(hash), "_%016llx",
+                static_cast<unsigned long long>(
+                    fnv1a(reinterpret_cast<const std::uint8_t*>(config.data()), config.size())));
+  return key + hash;
+}
+
+bool ifm3d_ros::UnitVectorCache::Load(const std::string& key, std::vector<std::uint8_t>& frame) const
+{
+  const std::string path = this->dir_ + "/" + key + ".uvec";
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat st;
+  UnitVectorCacheHeader header;
+  if ((::fstat(fd, &st) != 0) || (static_cast<std::size_t>(st.st_size) < sizeof(header)))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  const auto size = static_cast<std::size_t>(st.st_size);
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    return false;
+  }
+
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  std::memcpy(&header, bytes, sizeof(header));
+  const bool valid = (std::memcmp(header.magic, UVEC_MAGIC, sizeof(UVEC_MAGIC)) == 0) &&
+                     (header.version == UVEC_VERSION) && (header.size == size - sizeof(header)) &&
+                     (fnv1a(bytes + sizeof(header), size - sizeof(header)) == header.checksum);
+  if (valid)
+  {
+    frame.assign(bytes + sizeof(header), bytes + size);
+  }
+
+  ::munmap(data, size);
+  return valid;
+}
+
+void ifm3d_ros::UnitVectorCache::Store(const std::string& key, const std::vector<std::uint8_t>& frame) const
+{
+  make_dirs(this->dir_);
+
+  // written next to the file and renamed, readers see the complete frame or none
+  const std::string path = this->dir_ + "/" + key + ".uvec";
+  const std::string tmp_path = path + "." + std::to_string(::getpid()) + ".tmp";
+  const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    throw io_error("Could not create", tmp_path);
+  }
+
+  UnitVectorCacheHeader header;
+  std::memcpy(header.magic, UVEC_MAGIC, sizeof(UVEC_MAGIC));
+  header.version = UVEC_VERSION;
+  header.reserved = 0;
+  header.size = frame.size();
+  header.checksum = fnv1a(frame.data(), frame.size());
+  try
+  {
+    write_all(fd, &header, sizeof(header), tmp_path);
+    write_all(fd, frame.data(), frame.size(), tmp_path);
+    if (::fsync(fd) != 0)
+    {
+      throw io_error("Could not sync", tmp_path);
+    }
+  }
+  catch (const std::runtime_error&)
+  {
+    ::close(fd);
+    ::unlink(tmp_path.c_str());
+    throw;
+  }
+
+  ::close(fd);
+  if (::rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    const std::runtime_error ex = io_error("Could not rename", tmp_path);
+    ::unlink(tmp_path.c_str());
+    throw ex;
+  }
+}
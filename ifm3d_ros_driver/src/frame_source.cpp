@@ -0,0 +1,291 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/frame_source.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+//
+// The PCIC image chunks as sent by the camera: a header of 12 little endian
+// 32 bit values (version 2) followed by the pixel data
+//
+constexpr std::uint32_t CHUNK_HEADER_SIZE = 48;
+constexpr std::uint32_t CHUNK_HEADER_VERSION = 2;
+constexpr std::size_t CHUNK_TIMESTAMP_OFFSET = 28;  // microseconds, wrapping
+constexpr std::size_t CHUNK_FRAME_COUNT_OFFSET = 32;
+constexpr std::size_t CHUNK_TIMESTAMP_SEC_OFFSET = 40;
+constexpr std::size_t CHUNK_TIMESTAMP_NSEC_OFFSET = 44;
+
+constexpr std::uint32_t RADIAL_DISTANCE_IMAGE = 100;
+constexpr std::uint32_t NORM_AMPLITUDE_IMAGE = 101;
+constexpr std::uint32_t AMPLITUDE_IMAGE = 103;
+constexpr std::uint32_t GRAYSCALE_IMAGE = 104;
+constexpr std::uint32_t RADIAL_DISTANCE_NOISE = 105;
+constexpr std::uint32_t CARTESIAN_X_COMPONENT = 200;
+constexpr std::uint32_t CARTESIAN_Y_COMPONENT = 201;
+constexpr std::uint32_t CARTESIAN_Z_COMPONENT = 202;
+constexpr std::uint32_t UNIT_VECTOR_ALL = 223;
+constexpr std::uint32_t CONFIDENCE_IMAGE = 300;
+constexpr std::uint32_t EXTRINSIC_CALIB = 400;
+
+// horizontal field of view of the mocked head (radians)
+constexpr float FIELD_OF_VIEW = 1.05f;
+
+// extrinsic calibration of the mocked head: translation (mm) and rotation (rad) of the optical frame
+constexpr float EXTRINSICS[6] = { 25.0f, -40.0f, 60.0f, 0.0f, 0.0f, 0.0f };
+
+void put_u32(std::vector<std::uint8_t>& bytes, std::size_t offset, std::uint32_t value)
+{
+  for (std::size_t i = 0; i < 4; ++i)
+  {
+    bytes[offset + i] = static_cast<std::uint8_t>(value >> (8 * i));
+  }
+}
+
+std::uint32_t format_code(ifm3d::pixel_format format)
+{
+  return static_cast<std::uint32_t>(format);
+}
+}  // namespace
+
+//-------------------------------
+// FrameGrabberSource
+//-------------------------------
+ifm3d_ros::FrameGrabberSource::FrameGrabberSource(ifm3d::CameraBase::Ptr cam, std::uint16_t mask,
+                                                  std::uint16_t pcic_port)
+  : fg_(std::move(cam), mask, pcic_port)
+{
+}
+
+bool ifm3d_ros::FrameGrabberSource::WaitForFrame(ifm3d::StlImageBuffer* buffer, long timeout_millis)
+{
+  return this->fg_.WaitForFrame(buffer, timeout_millis);
+}
+
+void ifm3d_ros::FrameGrabberSource::SWTrigger()
+{
+  this->fg_.SWTrigger();
+}
+
+//-------------------------------
+// MockFrameSource
+//-------------------------------
+ifm3d_ros::MockFrameSource::MockFrameSource(std::uint16_t mask, std::uint32_t width, std::uint32_t height,
+                                            double rate)
+  : period_(rate > 0.0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                             std::chrono::duration<double>(1.0 / rate)) :
+                         std::chrono::steady_clock::duration::zero())
+  , next_(std::chrono::steady_clock::now())
+{
+  const std::size_t n = static_cast<std::size_t>(width) * height;
+
+  //
+  // The scene: the rays of a pinhole camera (optical frame) hitting a plane
+  // 2 m ahead, tilted towards the bottom of the image
+  //
+  const float f = static_cast<float>(width) / (2.0f * std::tan(FIELD_OF_VIEW / 2.0f));
+  const float cx = static_cast<float>(width) / 2.0f;
+  const float cy = static_cast<float>(height) / 2.0f;
+
+  std::vector<float> uvec(3 * n);
+  std::vector<float> distance(n);
+  std::vector<float> amplitude(n);
+  std::vector<float> x(n);
+  std::vector<float> y(n);
+  std::vector<float> z(n);
+  std::vector<std::uint16_t> confidence(n, 0);
+  for (std::uint32_t row = 0; row < height; ++row)
+  {
+    for (std::uint32_t col = 0; col < width; ++col)
+    {
+      const std::size_t i = static_cast<std::size_t>(row) * width + col;
+      const float rx = (static_cast<float>(col) - cx) / f;
+      const float ry = (static_cast<float>(row) - cy) / f;
+      const float norm = std::sqrt(rx * rx + ry * ry + 1.0f);
+      const float ex = rx / norm;
+      const float ey = ry / norm;
+      const float ez = 1.0f / norm;
+
+      // the plane z = 2 + 0.3 y (optical frame)
+      const float d = 2.0f / (ez - 0.3f * ey);
+      uvec[3 * i] = ex;
+      uvec[3 * i + 1] = ey;
+      uvec[3 * i + 2] = ez;
+      distance[i] = d;
+      amplitude[i] = 1000.0f / (d * d);
+
+      // the cartesian images are in the camera frame (x forward, y left, z
+      // up) and in m, translated by the extrinsic calibration
+      x[i] = d * ez + EXTRINSICS[2] / 1000.0f;
+      y[i] = -(d * ex + EXTRINSICS[0] / 1000.0f);
+      z[i] = -(d * ey + EXTRINSICS[1] / 1000.0f);
+
+      // a sprinkling of invalid pixels
+      confidence[i] = ((i % 97) == 0) ? 0x1 : 0x0;
+    }
+  }
+
+  const std::uint32_t f32 = format_code(ifm3d::pixel_format::FORMAT_32F);
+  const std::size_t image_size = n * sizeof(float);
+
+  // PCIC ticket and start sequence
+  const char start[] = "0000star";
+  this->frame_.assign(start, start + 8);
+
+  if ((mask & ifm3d::IMG_UVEC) == ifm3d::IMG_UVEC)
+  {
+    this->AddChunk(UNIT_VECTOR_ALL, width, height, format_code(ifm3d::pixel_format::FORMAT_32F3), uvec.data(),
+                   3 * image_size);
+  }
+  if ((mask & ifm3d::IMG_RDIS) == ifm3d::IMG_RDIS)
+  {
+    this->AddChunk(RADIAL_DISTANCE_IMAGE, width, height, f32, distance.data(), image_size);
+  }
+  if ((mask & ifm3d::IMG_DIS_NOISE) == ifm3d::IMG_DIS_NOISE)
+  {
+    std::vector<float> noise(n, 0.005f);
+    this->AddChunk(RADIAL_DISTANCE_NOISE, width, height, f32, noise.data(), image_size);
+  }
+  if ((mask & ifm3d::IMG_AMP) == ifm3d::IMG_AMP)
+  {
+    this->AddChunk(NORM_AMPLITUDE_IMAGE, width, height, f32, amplitude.data(), image_size);
+  }
+  if ((mask & ifm3d::IMG_RAMP) == ifm3d::IMG_RAMP)
+  {
+    this->AddChunk(AMPLITUDE_IMAGE, width, height, f32, amplitude.data(), image_size);
+  }
+  if ((mask & ifm3d::IMG_GRAY) == ifm3d::IMG_GRAY)
+  {
+    this->AddChunk(GRAYSCALE_IMAGE, width, height, f32, amplitude.data(), image_size);
+  }
+  if ((mask & ifm3d::IMG_CART) == ifm3d::IMG_CART)
+  {
+    this->AddChunk(CARTESIAN_X_COMPONENT, width, height, f32, x.data(), image_size);
+    this->AddChunk(CARTESIAN_Y_COMPONENT, width, height, f32, y.data(), image_size);
+    this->AddChunk(CARTESIAN_Z_COMPONENT, width, height, f32, z.data(), image_size);
+  }
+
+  // streamed independently of the mask
+  this->AddChunk(CONFIDENCE_IMAGE, width, height, format_code(ifm3d::pixel_format::FORMAT_16U), confidence.data(),
+                 n * sizeof(std::uint16_t));
+  this->AddChunk(EXTRINSIC_CALIB, 6, 1, f32, EXTRINSICS, sizeof(EXTRINSICS));
+
+  const char stop[] = "stop\r\n";
+  this->frame_.insert(this->frame_.end(), stop, stop + 6);
+}
+
+void ifm3d_ros::MockFrameSource::AddChunk(std::uint32_t type, std::uint32_t width, std::uint32_t height,
+                                          std::uint32_t pixel_format, const void* data, std::size_t size)
+{
+  const std::size_t offset = this->frame_.size();
+  this->frame_.resize(offset + CHUNK_HEADER_SIZE + size, 0);
+
+  put_u32(this->frame_, offset, type);
+  put_u32(this->frame_, offset + 4, static_cast<std::uint32_t>(CHUNK_HEADER_SIZE + size));
+  put_u32(this->frame_, offset + 8, CHUNK_HEADER_SIZE);
+  put_u32(this->frame_, offset + 12, CHUNK_HEADER_VERSION);
+  put_u32(this->frame_, offset + 16, width);
+  put_u32(this->frame_, offset + 20, height);
+  put_u32(this->frame_, offset + 24, pixel_format);
+  // the timestamps and the frame count are filled in by `Stamp()`, the status code stays 0
+
+  // the pixel data is little endian, like the host's
+  const auto* bytes = static_cast<const std::uint8_t*>(data);
+  std::copy(bytes, bytes + size, this->frame_.begin() + offset + CHUNK_HEADER_SIZE);
+
+  this->chunks_.push_back(offset);
+}
+
+void ifm3d_ros::MockFrameSource::Stamp()
+{
+  const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  const auto sec = static_cast<std::uint32_t>(now / 1000000000);
+  const auto nsec = static_cast<std::uint32_t>(now % 1000000000);
+  const auto usec = static_cast<std::uint32_t>(now / 1000);
+
+  ++this->frame_count_;
+  for (std::size_t offset : this->chunks_)
+  {
+    put_u32(this->frame_, offset + CHUNK_TIMESTAMP_OFFSET, usec);
+    put_u32(this->frame_, offset + CHUNK_FRAME_COUNT_OFFSET, this->frame_count_);
+    put_u32(this->frame_, offset + CHUNK_TIMESTAMP_SEC_OFFSET, sec);
+    put_u32(this->frame_, offset + CHUNK_TIMESTAMP_NSEC_OFFSET, nsec);
+  }
+}
+
+bool ifm3d_ros::MockFrameSource::WaitForFrame(ifm3d::StlImageBuffer* buffer, long timeout_millis)
+{
+  const auto timeout = std::chrono::milliseconds(timeout_millis);
+
+  if (this->period_ > std::chrono::steady_clock::duration::zero())
+  {
+    // free running: like the camera, frames which were not picked up in time are skipped
+    const auto now = std::chrono::steady_clock::now();
+    if ((timeout_millis > 0) && (this->next_ > now + timeout))
+    {
+      std::this_thread::sleep_for(timeout);
+      return false;
+    }
+
+    std::this_thread::sleep_until(this->next_);
+    this->next_ += this->period_;
+    this->next_ = std::max(this->next_, std::chrono::steady_clock::now());
+  }
+  else
+  {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    const auto triggered = [this] { return this->pending_triggers_ > 0; };
+    if (timeout_millis > 0)
+    {
+      if (!this->triggered_cv_.wait_for(lock, timeout, triggered))
+      {
+        return false;
+      }
+    }
+    else
+    {
+      this->triggered_cv_.wait(lock, triggered);
+    }
+
+    --this->pending_triggers_;
+  }
+
+  this->Stamp();
+  buffer->SetBytes(this->frame_, true);
+  return true;
+}
+
+void ifm3d_ros::MockFrameSource::SWTrigger()
+{
+  // ignored while free running, like by a camera in continuous mode
+  if (this->period_ > std::chrono::steady_clock::duration::zero())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    ++this->pending_triggers_;
+  }
+
+  this->triggered_cv_.notify_one();
+}
+
+bool ifm3d_ros::MockFrameSource::FrameCount(std::uint32_t& count) const
+{
+  count = this->frame_count_;
+  return this->frame_count_ > 0;
+}
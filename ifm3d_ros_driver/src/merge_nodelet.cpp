@@ -0,0 +1,154 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/merge_nodelet.h>
+#include <ifm3d_ros_driver/conversions.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+
+namespace
+{
+using Matrix = std::array<float, 16>;
+
+constexpr Matrix IDENTITY = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+}  // namespace
+
+void ifm3d_ros::MergeNodelet::onInit()
+{
+  NODELET_DEBUG_STREAM("onInit(): " << this->getName());
+
+  this->np_ = getMTPrivateNodeHandle();
+  ros::NodeHandle nh = getMTNodeHandle();
+
+  //
+  // parse data out of the parameter server
+  //
+  this->np_.param("inputs", this->inputs_, std::vector<std::string>());
+  this->np_.param("frame_id", this->frame_id_, std::string());
+  this->np_.param("sync_tolerance_secs", this->sync_tolerance_secs_, 0.025);
+  this->np_.param("buffer_pool_depth", this->buffer_pool_depth_, 4);
+
+  if (this->inputs_.empty())
+  {
+    NODELET_ERROR_STREAM("No inputs to merge, set `inputs`");
+  }
+
+  const std::size_t num_inputs = this->inputs_.size();
+  this->static_transforms_.assign(num_inputs, IDENTITY);
+  this->latest_.resize(num_inputs);
+  this->merge_set_.resize(num_inputs);
+
+  for (std::size_t i = 0; i < num_inputs; ++i)
+  {
+    // optional row-major 4x4 (or 3x4) matrix transforming the input into the common frame
+    std::vector<double> transform;
+    if (this->np_.getParam(this->inputs_[i] + "/transform", transform))
+    {
+      if ((transform.size() == 16) || (transform.size() == 12))
+      {
+        std::copy(transform.begin(), transform.end(), this->static_transforms_[i].begin());
+      }
+      else
+      {
+        NODELET_ERROR("%s/transform needs 12 or 16 values, got %zu, using identity", this->inputs_[i].c_str(),
+                      transform.size());
+      }
+    }
+  }
+
+  //-------------------
+  // Published topics
+  //-------------------
+  this->cloud_pub_ = this->np_.advertise<sensor_msgs::PointCloud2>("cloud", 1);
+  this->cloud_pool_ = ifm3d_ros::MessagePool<sensor_msgs::PointCloud2>::MakeShared(
+      static_cast<std::size_t>(std::max(this->buffer_pool_depth_, 1)));
+
+  //--------------------
+  // Subscribed topics
+  //--------------------
+  for (std::size_t i = 0; i < num_inputs; ++i)
+  {
+    this->cloud_subs_.push_back(nh.subscribe<sensor_msgs::PointCloud2>(
+        this->inputs_[i] + "/cloud", 2,
+        [this, i](const sensor_msgs::PointCloud2ConstPtr& cloud) { this->CloudCallback(i, cloud); }));
+  }
+}
+
+void ifm3d_ros::MergeNodelet::CloudCallback(std::size_t input, const sensor_msgs::PointCloud2ConstPtr& cloud)
+{
+  sensor_msgs::PointCloud2Ptr merged;
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->latest_[input] = cloud;
+
+    //
+    // Pair the latest clouds of all inputs: clouds older than the newest one
+    // by more than the tolerance will never be part of a set and are dropped.
+    //
+    ros::Time newest = cloud->header.stamp;
+    for (const auto& latest : this->latest_)
+    {
+      if (latest && (latest->header.stamp > newest))
+      {
+        newest = latest->header.stamp;
+      }
+    }
+
+    bool complete = true;
+    for (auto& latest : this->latest_)
+    {
+      if (latest && ((newest - latest->header.stamp).toSec() > this->sync_tolerance_secs_))
+      {
+        NODELET_DEBUG_STREAM("dropping unpaired cloud of " << latest->header.frame_id);
+        latest.reset();
+      }
+
+      complete = complete && latest;
+    }
+
+    if (!complete)
+    {
+      return;
+    }
+
+    for (std::size_t i = 0; i < this->latest_.size(); ++i)
+    {
+      this->merge_set_[i] = std::move(this->latest_[i]);
+    }
+
+    if (this->cloud_pub_.getNumSubscribers() > 0)
+    {
+      this->header_.stamp = newest;
+      this->header_.frame_id = this->frame_id_.empty() ? this->merge_set_[0]->header.frame_id : this->frame_id_;
+
+      merged = this->cloud_pool_->Acquire();
+      merge_clouds(this->merge_set_, this->static_transforms_, this->header_, getName(), *merged);
+    }
+
+    // hand the input clouds back to their publishers' pools
+    for (auto& merge : this->merge_set_)
+    {
+      merge.reset();
+    }
+  }
+
+  if (merged)
+  {
+    this->cloud_pub_.publish(merged);
+  }
+}
+
+PLUGINLIB_EXPORT_CLASS(ifm3d_ros::MergeNodelet, nodelet::Nodelet)
@@ -0,0 +1,611 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/point_cloud_kernels.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define IFM3D_ROS_HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+#if defined(__SSE2__)
+#define IFM3D_ROS_HAVE_SSE2_KERNELS 1
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IFM3D_ROS_HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+using ifm3d_ros::Confidence;
+
+namespace
+{
+//
+// Scalar kernels, they process the pixels [begin, n) and also take care of
+// the remainders of the vectorized ones
+//
+bool is_valid(const Confidence& confidence, std::size_t i)
+{
+  const std::uint16_t value = confidence.wide ? static_cast<const std::uint16_t*>(confidence.data)[i] :
+                                                static_cast<const std::uint8_t*>(confidence.data)[i];
+  return (value & confidence.invalid_bits) == 0;
+}
+
+std::size_t compute_xyz_scalar(const float* uvec, const float* distance, const float* translation,
+                               const Confidence& confidence, float* xyz, std::size_t begin, std::size_t n)
+{
+  const bool masked = confidence.data != nullptr;
+  const float fill = masked ? std::numeric_limits<float>::quiet_NaN() : 0.0f;
+  std::size_t invalid = 0;
+
+  for (std::size_t i = begin; i < n; ++i)
+  {
+    const float d = distance[i];
+    if ((d > 0.0f) && (!masked || is_valid(confidence, i)))
+    {
+      xyz[3 * i + 0] = uvec[3 * i + 0] * d + translation[0];
+      xyz[3 * i + 1] = uvec[3 * i + 1] * d + translation[1];
+      xyz[3 * i + 2] = uvec[3 * i + 2] * d + translation[2];
+    }
+    else
+    {
+      xyz[3 * i + 0] = fill;
+      xyz[3 * i + 1] = fill;
+      xyz[3 * i + 2] = fill;
+      ++invalid;
+    }
+  }
+
+  return masked ? invalid : 0;
+}
+
+std::size_t copy_xyz_scalar(const float* src, const Confidence& confidence, float* xyz, std::size_t begin,
+                            std::size_t n)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::size_t invalid = 0;
+
+  for (std::size_t i = begin; i < n; ++i)
+  {
+    if (is_valid(confidence, i))
+    {
+      xyz[3 * i + 0] = src[3 * i + 0];
+      xyz[3 * i + 1] = src[3 * i + 1];
+      xyz[3 * i + 2] = src[3 * i + 2];
+    }
+    else
+    {
+      xyz[3 * i + 0] = nan;
+      xyz[3 * i + 1] = nan;
+      xyz[3 * i + 2] = nan;
+      ++invalid;
+    }
+  }
+
+  return invalid;
+}
+
+#if defined(IFM3D_ROS_HAVE_AVX2_KERNELS)
+bool have_avx2()
+{
+  static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return avx2;
+}
+
+// all bits set in the lanes of the 8 pixels starting at `i` which are valid
+__attribute__((target("avx2,fma"))) inline __m256 load_valid_avx2(const Confidence& confidence, std::size_t i)
+{
+  __m256i values;
+  if (confidence.wide)
+  {
+    const auto* src = static_cast<const std::uint16_t*>(confidence.data) + i;
+    values = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+  }
+  else
+  {
+    const auto* src = static_cast<const std::uint8_t*>(confidence.data) + i;
+    values = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+  }
+
+  const __m256i bits = _mm256_and_si256(values, _mm256_set1_epi32(confidence.invalid_bits));
+  return _mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, _mm256_setzero_si256()));
+}
+
+// 8 pixels per iteration: their interleaved x, y, z values span three
+// registers, per pixel values (distance, validity) are broadcast to the
+// matching lanes by permutation.
+__attribute__((target("avx2,fma"))) std::size_t compute_xyz_avx2(const float* uvec, const float* distance,
+                                                                  const float* translation,
+                                                                  const Confidence& confidence, float* xyz,
+                                                                  std::size_t n, std::size_t& invalid)
+{
+  const float tx = translation[0];
+  const float ty = translation[1];
+  const float tz = translation[2];
+  const bool masked = confidence.data != nullptr;
+
+  const __m256i p0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+  const __m256i p1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+  const __m256i p2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+  const __m256 t0 = _mm256_setr_ps(tx, ty, tz, tx, ty, tz, tx, ty);
+  const __m256 t1 = _mm256_setr_ps(tz, tx, ty, tz, tx, ty, tz, tx);
+  const __m256 t2 = _mm256_setr_ps(ty, tz, tx, ty, tz, tx, ty, tz);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 fill = masked ? _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()) : zero;
+
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    const __m256 d = _mm256_loadu_ps(distance + i);
+    __m256 valid = _mm256_cmp_ps(d, zero, _CMP_GT_OQ);
+    if (masked)
+    {
+      valid = _mm256_and_ps(valid, load_valid_avx2(confidence, i));
+      invalid += 8 - __builtin_popcount(_mm256_movemask_ps(valid));
+    }
+
+    const float* u = uvec + 3 * i;
+    const __m256 r0 = _mm256_fmadd_ps(_mm256_loadu_ps(u + 0), _mm256_permutevar8x32_ps(d, p0), t0);
+    const __m256 r1 = _mm256_fmadd_ps(_mm256_loadu_ps(u + 8), _mm256_permutevar8x32_ps(d, p1), t1);
+    const __m256 r2 = _mm256_fmadd_ps(_mm256_loadu_ps(u + 16), _mm256_permutevar8x32_ps(d, p2), t2);
+
+    float* out = xyz + 3 * i;
+    _mm256_storeu_ps(out + 0, _mm256_blendv_ps(fill, r0, _mm256_permutevar8x32_ps(valid, p0)));
+    _mm256_storeu_ps(out + 8, _mm256_blendv_ps(fill, r1, _mm256_permutevar8x32_ps(valid, p1)));
+    _mm256_storeu_ps(out + 16, _mm256_blendv_ps(fill, r2, _mm256_permutevar8x32_ps(valid, p2)));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2,fma"))) std::size_t copy_xyz_avx2(const float* src, const Confidence& confidence,
+                                                               float* xyz, std::size_t n, std::size_t& invalid)
+{
+  const __m256i p0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+  const __m256i p1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+  const __m256i p2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+  const __m256 nan = _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    const __m256 valid = load_valid_avx2(confidence, i);
+    invalid += 8 - __builtin_popcount(_mm256_movemask_ps(valid));
+
+    const float* s = src + 3 * i;
+    float* out = xyz + 3 * i;
+    _mm256_storeu_ps(out + 0, _mm256_blendv_ps(nan, _mm256_loadu_ps(s + 0), _mm256_permutevar8x32_ps(valid, p0)));
+    _mm256_storeu_ps(out + 8, _mm256_blendv_ps(nan, _mm256_loadu_ps(s + 8), _mm256_permutevar8x32_ps(valid, p1)));
+    _mm256_storeu_ps(out + 16, _mm256_blendv_ps(nan, _mm256_loadu_ps(s + 16), _mm256_permutevar8x32_ps(valid, p2)));
+  }
+
+  return i;
+}
+#endif
+
+#if defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+// all bits set in the lanes of the 4 pixels starting at `i` which are valid
+inline uint32x4_t load_valid_neon(const Confidence& confidence, std::size_t i)
+{
+  std::uint32_t values[4];
+  for (std::size_t k = 0; k < 4; ++k)
+  {
+    values[k] = confidence.wide ? static_cast<const std::uint16_t*>(confidence.data)[i + k] :
+                                  static_cast<const std::uint8_t*>(confidence.data)[i + k];
+  }
+
+  const uint32x4_t bits = vandq_u32(vld1q_u32(values), vdupq_n_u32(confidence.invalid_bits));
+  return vceqq_u32(bits, vdupq_n_u32(0));
+}
+
+inline std::size_t count_invalid_neon(uint32x4_t valid)
+{
+  const uint32x4_t ones = vshrq_n_u32(valid, 31);
+  const uint32x2_t sum = vadd_u32(vget_low_u32(ones), vget_high_u32(ones));
+  return 4 - vget_lane_u32(vpadd_u32(sum, sum), 0);
+}
+
+// 4 pixels per iteration, the structure loads/stores do the de-/interleaving
+std::size_t compute_xyz_neon(const float* uvec, const float* distance, const float* translation,
+                             const Confidence& confidence, float* xyz, std::size_t n, std::size_t& invalid)
+{
+  const float32x4_t tx = vdupq_n_f32(translation[0]);
+  const float32x4_t ty = vdupq_n_f32(translation[1]);
+  const float32x4_t tz = vdupq_n_f32(translation[2]);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  const bool masked = confidence.data != nullptr;
+  const float32x4_t fill = masked ? vdupq_n_f32(std::numeric_limits<float>::quiet_NaN()) : zero;
+
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const float32x4_t d = vld1q_f32(distance + i);
+    uint32x4_t valid = vcgtq_f32(d, zero);
+    if (masked)
+    {
+      valid = vandq_u32(valid, load_valid_neon(confidence, i));
+      invalid += count_invalid_neon(valid);
+    }
+
+    const float32x4x3_t u = vld3q_f32(uvec + 3 * i);
+    float32x4x3_t r;
+    r.val[0] = vbslq_f32(valid, vmlaq_f32(tx, u.val[0], d), fill);
+    r.val[1] = vbslq_f32(valid, vmlaq_f32(ty, u.val[1], d), fill);
+    r.val[2] = vbslq_f32(valid, vmlaq_f32(tz, u.val[2], d), fill);
+    vst3q_f32(xyz + 3 * i, r);
+  }
+
+  return i;
+}
+
+std::size_t copy_xyz_neon(const float* src, const Confidence& confidence, float* xyz, std::size_t n,
+                          std::size_t& invalid)
+{
+  const float32x4_t nan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const uint32x4_t valid = load_valid_neon(confidence, i);
+    invalid += count_invalid_neon(valid);
+
+    float32x4x3_t p = vld3q_f32(src + 3 * i);
+    for (int k = 0; k < 3; ++k)
+    {
+      p.val[k] = vbslq_f32(valid, p.val[k], nan);
+    }
+    vst3q_f32(xyz + 3 * i, p);
+  }
+
+  return i;
+}
+#endif
+
+//
+// Stream compaction: every point is stored unconditionally at the current
+// output position, which only advances for valid points. This avoids the
+// unpredictable branches on the validity of the points.
+//
+std::size_t compact_xyz_scalar(const float* xyz, std::size_t begin, std::size_t n, bool pixel_index, float* out,
+                               std::size_t count)
+{
+  const std::size_t stride = pixel_index ? 4 : 3;
+
+  for (std::size_t i = begin; i < n; ++i)
+  {
+    float* dst = out + stride * count;
+    std::memcpy(dst, xyz + 3 * i, 3 * sizeof(float));
+    if (pixel_index)
+    {
+      const auto index = static_cast<std::uint32_t>(i);
+      std::memcpy(dst + 3, &index, sizeof(index));
+    }
+
+    count += (xyz[3 * i] == xyz[3 * i]) ? 1 : 0;
+  }
+
+  return count;
+}
+
+#if defined(IFM3D_ROS_HAVE_SSE2_KERNELS)
+// The 16 byte loads read the x value of the next point, the last point is
+// left to the scalar kernel. Returns the number of points processed.
+std::size_t compact_xyz_sse2(const float* xyz, std::size_t n, bool pixel_index, float* out, std::size_t& count)
+{
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  std::size_t i = 0;
+  if (pixel_index)
+  {
+    const __m128i xyz_lanes = _mm_setr_epi32(-1, -1, -1, 0);
+    for (; i + 1 < n; ++i)
+    {
+      const __m128 p = _mm_loadu_ps(xyz + 3 * i);
+      const __m128i index = _mm_set1_epi32(static_cast<int>(i));
+      const __m128i point =
+          _mm_or_si128(_mm_and_si128(_mm_castps_si128(p), xyz_lanes), _mm_andnot_si128(xyz_lanes, index));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * count), point);
+      count += _mm_movemask_ps(_mm_cmpord_ss(p, p)) & 0x1;
+    }
+  }
+  else
+  {
+    for (; i + 1 < n; ++i)
+    {
+      const __m128 p = _mm_loadu_ps(xyz + 3 * i);
+      _mm_storeu_ps(out + 3 * count, p);
+      count += _mm_movemask_ps(_mm_cmpord_ss(p, p)) & 0x1;
+    }
+  }
+
+  return i;
+}
+#endif
+
+#if defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+// same as the SSE2 kernel
+std::size_t compact_xyz_neon(const float* xyz, std::size_t n, bool pixel_index, float* out, std::size_t& count)
+{
+  if (n == 0)
+  {
+    return 0;
+  }
+
+  std::size_t i = 0;
+  if (pixel_index)
+  {
+    for (; i + 1 < n; ++i)
+    {
+      const float32x4_t p = vld1q_f32(xyz + 3 * i);
+      const uint32x4_t point = vsetq_lane_u32(static_cast<std::uint32_t>(i), vreinterpretq_u32_f32(p), 3);
+      vst1q_u32(reinterpret_cast<std::uint32_t*>(out + 4 * count), point);
+      count += (xyz[3 * i] == xyz[3 * i]) ? 1 : 0;
+    }
+  }
+  else
+  {
+    for (; i + 1 < n; ++i)
+    {
+      vst1q_f32(out + 3 * count, vld1q_f32(xyz + 3 * i));
+      count += (xyz[3 * i] == xyz[3 * i]) ? 1 : 0;
+    }
+  }
+
+  return i;
+}
+#endif
+
+void transform_xyz_scalar(const float* m, const std::uint8_t* src, std::size_t point_step, std::size_t begin,
+                          std::size_t n, float* xyz)
+{
+  for (std::size_t i = begin; i < n; ++i)
+  {
+    float p[3];
+    std::memcpy(p, src + point_step * i, sizeof(p));
+    xyz[3 * i] = m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3];
+    xyz[3 * i + 1] = m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7];
+    xyz[3 * i + 2] = m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11];
+  }
+}
+
+#if defined(IFM3D_ROS_HAVE_SSE2_KERNELS)
+// One point per iteration: its coordinates are broadcast and multiplied with
+// the columns of the matrix. The 16 byte loads and stores touch the next
+// point, so the last point is left to the scalar kernel. Returns the number
+// of points processed.
+std::size_t transform_xyz_sse2(const float* m, const std::uint8_t* src, std::size_t point_step, std::size_t n,
+                               float* xyz)
+{
+  const __m128 c0 = _mm_setr_ps(m[0], m[4], m[8], 0.f);
+  const __m128 c1 = _mm_setr_ps(m[1], m[5], m[9], 0.f);
+  const __m128 c2 = _mm_setr_ps(m[2], m[6], m[10], 0.f);
+  const __m128 c3 = _mm_setr_ps(m[3], m[7], m[11], 0.f);
+
+  std::size_t i = 0;
+  for (; i + 1 < n; ++i)
+  {
+    const __m128 p = _mm_loadu_ps(reinterpret_cast<const float*>(src + point_step * i));
+    const __m128 x = _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0));
+    const __m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
+    const __m128 z = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x), _mm_mul_ps(c1, y)), _mm_add_ps(_mm_mul_ps(c2, z), c3));
+    _mm_storeu_ps(xyz + 3 * i, r);
+  }
+
+  return i;
+}
+#endif
+
+#if defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+// same as the SSE2 kernel
+std::size_t transform_xyz_neon(const float* m, const std::uint8_t* src, std::size_t point_step, std::size_t n,
+                               float* xyz)
+{
+  const float32x4_t c0 = { m[0], m[4], m[8], 0.f };
+  const float32x4_t c1 = { m[1], m[5], m[9], 0.f };
+  const float32x4_t c2 = { m[2], m[6], m[10], 0.f };
+  const float32x4_t c3 = { m[3], m[7], m[11], 0.f };
+
+  std::size_t i = 0;
+  for (; i + 1 < n; ++i)
+  {
+    const float32x4_t p = vld1q_f32(reinterpret_cast<const float*>(src + point_step * i));
+    float32x4_t r = vmlaq_n_f32(c3, c0, vgetq_lane_f32(p, 0));
+    r = vmlaq_n_f32(r, c1, vgetq_lane_f32(p, 1));
+    r = vmlaq_n_f32(r, c2, vgetq_lane_f32(p, 2));
+    vst1q_f32(xyz + 3 * i, r);
+  }
+
+  return i;
+}
+#endif
+
+//
+// The points are interleaved in blocks small enough to stay in the L1 cache:
+// first the coordinates, then one channel after the other, so that the pixel
+// format is dispatched once per block and channel only.
+//
+constexpr std::size_t INTERLEAVE_BLOCK = 128;
+
+template <typename Src, typename Dst>
+void store_channel(const void* data, std::size_t begin, std::size_t end, std::size_t point_step, std::uint8_t* field)
+{
+  const auto* src = static_cast<const Src*>(data);
+  for (std::size_t i = begin; i < end; ++i)
+  {
+    // zero padded to 4 bytes, little endian like the rest of the cloud
+    const auto value = static_cast<Dst>(src[i]);
+    std::uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(value));
+    std::memcpy(field + point_step * i, &bits, sizeof(bits));
+  }
+}
+
+void store_channel(const ifm3d_ros::Channel& channel, std::size_t begin, std::size_t end, std::size_t point_step,
+                   std::uint8_t* field)
+{
+  using Format = ifm3d_ros::Channel::Format;
+
+  switch (channel.format)
+  {
+    case Format::FLOAT32:
+      store_channel<float, float>(channel.data, begin, end, point_step, field);
+      break;
+    case Format::UINT16_TO_FLOAT32:
+      store_channel<std::uint16_t, float>(channel.data, begin, end, point_step, field);
+      break;
+    case Format::UINT8_TO_FLOAT32:
+      store_channel<std::uint8_t, float>(channel.data, begin, end, point_step, field);
+      break;
+    case Format::UINT16:
+      store_channel<std::uint16_t, std::uint16_t>(channel.data, begin, end, point_step, field);
+      break;
+    case Format::UINT8_TO_UINT16:
+      store_channel<std::uint8_t, std::uint16_t>(channel.data, begin, end, point_step, field);
+      break;
+  }
+}
+
+// Copies the coordinates of the pixels [begin, end) with one 16 byte
+// load/store per point, the fourth lane lands in the first channel's field,
+// which is written afterwards. The load reads the x value of the next point,
+// so the last of the `n` points is copied on its own.
+void store_xyz(const float* xyz, std::size_t begin, std::size_t end, std::size_t n, std::size_t point_step,
+               std::uint8_t* out)
+{
+  const std::size_t vector_end = (end < n) ? end : end - 1;
+  std::size_t i = begin;
+
+#if defined(IFM3D_ROS_HAVE_SSE2_KERNELS)
+  for (; i < vector_end; ++i)
+  {
+    _mm_storeu_ps(reinterpret_cast<float*>(out + point_step * i), _mm_loadu_ps(xyz + 3 * i));
+  }
+#elif defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+  for (; i < vector_end; ++i)
+  {
+    vst1q_f32(reinterpret_cast<float*>(out + point_step * i), vld1q_f32(xyz + 3 * i));
+  }
+#endif
+
+  for (; i < end; ++i)
+  {
+    std::memcpy(out + point_step * i, xyz + 3 * i, 3 * sizeof(float));
+  }
+}
+}  // namespace
+
+std::size_t ifm3d_ros::ComputeXYZ(const float* uvec, const float* distance, const float* translation,
+                                  const Confidence& confidence, float* xyz, std::size_t n)
+{
+  std::size_t done = 0;
+  std::size_t invalid = 0;
+
+#if defined(IFM3D_ROS_HAVE_AVX2_KERNELS)
+  if (have_avx2())
+  {
+    done = compute_xyz_avx2(uvec, distance, translation, confidence, xyz, n, invalid);
+  }
+#elif defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+  done = compute_xyz_neon(uvec, distance, translation, confidence, xyz, n, invalid);
+#endif
+
+  return invalid + compute_xyz_scalar(uvec, distance, translation, confidence, xyz, done, n);
+}
+
+void ifm3d_ros::OpticalToCameraFrame(const float* uvec, float* out, std::size_t n)
+{
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const float ex = uvec[3 * i + 0];
+    const float ey = uvec[3 * i + 1];
+    const float ez = uvec[3 * i + 2];
+    out[3 * i + 0] = ez;
+    out[3 * i + 1] = -ex;
+    out[3 * i + 2] = -ey;
+  }
+}
+
+std::size_t ifm3d_ros::CopyXYZ(const float* src, const Confidence& confidence, float* xyz, std::size_t n)
+{
+  if (confidence.data == nullptr)
+  {
+    std::memcpy(xyz, src, 3 * n * sizeof(float));
+    return 0;
+  }
+
+  std::size_t done = 0;
+  std::size_t invalid = 0;
+
+#if defined(IFM3D_ROS_HAVE_AVX2_KERNELS)
+  if (have_avx2())
+  {
+    done = copy_xyz_avx2(src, confidence, xyz, n, invalid);
+  }
+#elif defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+  done = copy_xyz_neon(src, confidence, xyz, n, invalid);
+#endif
+
+  return invalid + copy_xyz_scalar(src, confidence, xyz, done, n);
+}
+
+std::size_t ifm3d_ros::CompactXYZ(const float* xyz, std::size_t n, bool pixel_index, float* out)
+{
+  std::size_t done = 0;
+  std::size_t count = 0;
+
+#if defined(IFM3D_ROS_HAVE_SSE2_KERNELS)
+  done = compact_xyz_sse2(xyz, n, pixel_index, out, count);
+#elif defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+  done = compact_xyz_neon(xyz, n, pixel_index, out, count);
+#endif
+
+  return compact_xyz_scalar(xyz, done, n, pixel_index, out, count);
+}
+
+void ifm3d_ros::InterleaveFields(const float* xyz, const Channel* channels, std::size_t num_channels, std::size_t n,
+                                 std::uint8_t* out)
+{
+  const std::size_t point_step = 12 + 4 * num_channels;
+  if (n == 0)
+  {
+    return;
+  }
+
+  if (num_channels == 0)
+  {
+    std::memcpy(out, xyz, point_step * n);
+    return;
+  }
+
+  for (std::size_t begin = 0; begin < n; begin += INTERLEAVE_BLOCK)
+  {
+    const std::size_t end = (n - begin > INTERLEAVE_BLOCK) ? begin + INTERLEAVE_BLOCK : n;
+    store_xyz(xyz, begin, end, n, point_step, out);
+    for (std::size_t c = 0; c < num_channels; ++c)
+    {
+      store_channel(channels[c], begin, end, point_step, out + 12 + 4 * c);
+    }
+  }
+}
+
+void ifm3d_ros::TransformXYZ(const float* m, const std::uint8_t* src, std::size_t point_step, std::size_t n, float* xyz)
+{
+  std::size_t done = 0;
+
+#if defined(IFM3D_ROS_HAVE_SSE2_KERNELS)
+  done = transform_xyz_sse2(m, src, point_step, n, xyz);
+#elif defined(IFM3D_ROS_HAVE_NEON_KERNELS)
+  done = transform_xyz_neon(m, src, point_step, n, xyz);
+#endif
+
+  transform_xyz_scalar(m, src, point_step, done, n, xyz);
+}
@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/reconnect.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//-------------------------------
+// Backoff
+//-------------------------------
+ifm3d_ros::Backoff::Backoff(double initial_secs, double max_secs, double jitter)
+  : initial_(std::max(initial_secs, 0.001))
+  , max_(std::max(max_secs, this->initial_))
+  , jitter_(std::min(std::max(jitter, 0.0), 1.0))
+  , current_(this->initial_)
+  , rng_(std::random_device()())
+{
+}
+
+std::chrono::steady_clock::duration ifm3d_ros::Backoff::Next()
+{
+  std::uniform_real_distribution<double> spread(1.0 - this->jitter_, 1.0);
+  const double delay = this->current_ * spread(this->rng_);
+  this->current_ = std::min(2.0 * this->current_, this->max_);
+
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(delay));
+}
+
+void ifm3d_ros::Backoff::Reset()
+{
+  this->current_ = this->initial_;
+}
+
+//-------------------------------
+// Probes
+//-------------------------------
+bool ifm3d_ros::ProbeTcp(const std::string& host, std::uint16_t port, int timeout_millis)
+{
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV;
+
+  addrinfo* addresses = nullptr;
+  if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+  {
+    return false;
+  }
+
+  bool reachable = false;
+  for (const addrinfo* address = addresses; (address != nullptr) && !reachable; address = address->ai_next)
+  {
+    const int fd = ::socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                            address->ai_protocol);
+    if (fd < 0)
+    {
+      continue;
+    }
+
+    if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+    {
+      reachable = true;
+    }
+    else if (errno == EINPROGRESS)
+    {
+      pollfd pfd{ fd, POLLOUT, 0 };
+      int error = 0;
+      socklen_t length = sizeof(error);
+      reachable = (::poll(&pfd, 1, std::max(timeout_millis, 1)) == 1) &&
+                  (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0) && (error == 0);
+    }
+
+    ::close(fd);
+  }
+
+  ::freeaddrinfo(addresses);
+  return reachable;
+}
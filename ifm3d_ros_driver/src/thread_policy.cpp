@@ -0,0 +1,138 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/thread_policy.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+void ifm3d_ros::ApplyThreadPolicy(const ThreadPolicy& policy)
+{
+  if (!policy.cpus.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : policy.cpus)
+    {
+      if ((cpu < 0) || (cpu >= CPU_SETSIZE))
+      {
+        throw std::runtime_error("Invalid CPU " + std::to_string(cpu));
+      }
+      CPU_SET(cpu, &set);
+    }
+
+    const int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    if (err != 0)
+    {
+      throw std::runtime_error("Could not pin the thread to CPUs " + Describe(ThreadPolicy{ 0, policy.cpus }) + ": " +
+                               std::strerror(err));
+    }
+  }
+
+  if (policy.priority > 0)
+  {
+    sched_param param{};
+    param.sched_priority = std::min(std::max(policy.priority, ::sched_get_priority_min(SCHED_FIFO)),
+                                    ::sched_get_priority_max(SCHED_FIFO));
+    const int err = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+    if (err != 0)
+    {
+      throw std::runtime_error("Could not set SCHED_FIFO priority " + std::to_string(param.sched_priority) + ": " +
+                               std::strerror(err));
+    }
+  }
+}
+
+std::string ifm3d_ros::Describe(const ThreadPolicy& policy)
+{
+  std::string description = (policy.priority > 0) ? "SCHED_FIFO " + std::to_string(policy.priority) : "SCHED_OTHER";
+  if (!policy.cpus.empty())
+  {
+    description += " on CPUs ";
+    for (std::size_t i = 0; i < policy.cpus.size(); ++i)
+    {
+      description += (i > 0 ? "," : "") + std::to_string(policy.cpus[i]);
+    }
+  }
+
+  return description;
+}
+
+void ifm3d_ros::LockMemory()
+{
+  if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+  {
+    throw std::runtime_error(std::string("Could not lock the memory: ") + std::strerror(errno));
+  }
+}
+
+void ifm3d_ros::PrefaultStack(std::size_t bytes)
+{
+  // below the caller's frame, i.e. where its callees will run
+  volatile char* stack = static_cast<volatile char*>(::alloca(bytes));
+  for (std::size_t i = 0; i < bytes; i += 4096)
+  {
+    stack[i] = 0;
+  }
+}
+
+//-------------------------------
+// ThreadUsage
+//-------------------------------
+void ifm3d_ros::ThreadUsage::Attach()
+{
+  clockid_t clock;
+  if (::pthread_getcpuclockid(::pthread_self(), &clock) == 0)
+  {
+    this->clock_ = clock;
+  }
+  this->tid_ = static_cast<int>(::syscall(SYS_gettid));
+}
+
+bool ifm3d_ros::ThreadUsage::Read(Sample& sample) const
+{
+  const int tid = this->tid_;
+  if (tid == 0)
+  {
+    return false;
+  }
+
+  timespec cpu{};
+  sample.cpu_secs = (::clock_gettime(this->clock_, &cpu) == 0) ? cpu.tv_sec + 1e-9 * cpu.tv_nsec : 0.0;
+  sample.voluntary_switches = 0;
+  sample.involuntary_switches = 0;
+
+  std::ifstream status("/proc/self/task/" + std::to_string(tid) + "/status");
+  if (!status)
+  {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(status, line))
+  {
+    if (line.compare(0, 24, "voluntary_ctxt_switches:") == 0)
+    {
+      sample.voluntary_switches = std::stoull(line.substr(24));
+    }
+    else if (line.compare(0, 27, "nonvoluntary_ctxt_switches:") == 0)
+    {
+      sample.involuntary_switches = std::stoull(line.substr(27));
+    }
+  }
+
+  return true;
+}
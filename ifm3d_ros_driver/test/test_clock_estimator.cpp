@@ -0,0 +1,160 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/clock_estimator.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+constexpr std::size_t WINDOW = 300;
+constexpr std::int64_t PERIOD_NS = 100000000;  // 10 Hz
+
+// the camera's clock is behind the host's one and slow by `DRIFT`
+constexpr std::int64_t CAMERA_START_NS = 1000000000000;
+constexpr std::int64_t HOST_START_NS = 1600000000000000000;
+constexpr double DRIFT = 50e-6;
+
+// every frame is received after the minimum latency plus up to `JITTER_NS`
+constexpr std::int64_t LATENCY_NS = 5000000;
+constexpr std::int64_t JITTER_NS = 1000000;
+
+// the mapped stamps are the capture times plus the minimum latency, up to
+constexpr std::int64_t TOLERANCE_NS = 500000;
+
+class Camera
+{
+public:
+  // the frame `i` as stamped by the camera and the time it was captured in the host's clock
+  std::int64_t CameraNs(std::size_t i) const
+  {
+    return CAMERA_START_NS + static_cast<std::int64_t>(i) * PERIOD_NS + this->jump_ns_;
+  }
+
+  std::int64_t CaptureNs(std::size_t i) const
+  {
+    return HOST_START_NS + std::llround(static_cast<double>(i) * PERIOD_NS * (1.0 + DRIFT));
+  }
+
+  std::int64_t ReceiveNs(std::size_t i)
+  {
+    return this->CaptureNs(i) + LATENCY_NS + this->jitter_(this->rng_);
+  }
+
+  // e.g. the camera synced its clock
+  void Jump(std::int64_t jump_ns)
+  {
+    this->jump_ns_ += jump_ns;
+  }
+
+private:
+  std::int64_t jump_ns_ = 0;
+  std::mt19937 rng_{ 42 };
+  std::uniform_int_distribution<std::int64_t> jitter_{ 0, JITTER_NS };
+};
+}  // namespace
+
+TEST(ClockEstimator, ConvergesToOffsetAndDrift)
+{
+  ifm3d_ros::ClockEstimator clock(WINDOW);
+  Camera camera;
+
+  for (std::size_t i = 0; i < 2 * WINDOW; ++i)
+  {
+    const std::int64_t receive_ns = camera.ReceiveNs(i);
+    const std::int64_t stamp_ns = clock.Update(camera.CameraNs(i), receive_ns);
+    EXPECT_LE(stamp_ns, receive_ns);
+
+    // once the window spans a few seconds
+    if (i >= WINDOW / 4)
+    {
+      EXPECT_NEAR(stamp_ns, camera.CaptureNs(i) + LATENCY_NS, TOLERANCE_NS) << "frame " << i;
+    }
+  }
+
+  const std::size_t last = 2 * WINDOW - 1;
+  EXPECT_EQ(clock.Samples(), WINDOW);
+  EXPECT_EQ(clock.Resets(), 0u);
+  EXPECT_NEAR(clock.DriftPpm(), DRIFT * 1e6, 5.0);
+  EXPECT_NEAR(clock.Offset(), (camera.CaptureNs(last) + LATENCY_NS - camera.CameraNs(last)) * 1e-9,
+              TOLERANCE_NS * 1e-9);
+  EXPECT_GT(clock.Jitter(), 0.0);
+  EXPECT_LT(clock.Jitter(), JITTER_NS * 1e-9);
+}
+
+TEST(ClockEstimator, IgnoresLatencySpikes)
+{
+  ifm3d_ros::ClockEstimator clock(WINDOW, 0.5);
+  Camera camera;
+
+  for (std::size_t i = 0; i < 2 * WINDOW; ++i)
+  {
+    const bool spike = (i % 25) == 24;
+    const std::int64_t receive_ns = camera.ReceiveNs(i) + (spike ? 2000000000 : 0);
+    const std::int64_t stamp_ns = clock.Update(camera.CameraNs(i), receive_ns);
+
+    // a late frame is stamped with its capture time, not when it was received
+    if (i >= WINDOW / 4)
+    {
+      EXPECT_NEAR(stamp_ns, camera.CaptureNs(i) + LATENCY_NS, TOLERANCE_NS) << "frame " << i;
+    }
+  }
+
+  EXPECT_EQ(clock.Resets(), 0u);
+  EXPECT_NEAR(clock.DriftPpm(), DRIFT * 1e6, 5.0);
+  EXPECT_LT(clock.Jitter(), JITTER_NS * 1e-9);
+}
+
+TEST(ClockEstimator, RestartsOnClockJump)
+{
+  ifm3d_ros::ClockEstimator clock(WINDOW, 0.5);
+  Camera camera;
+
+  std::int64_t previous_ns = 0;
+  for (std::size_t i = 0; i < 3 * WINDOW; ++i)
+  {
+    if (i == WINDOW)
+    {
+      camera.Jump(-100000000000);
+    }
+
+    const std::int64_t receive_ns = camera.ReceiveNs(i);
+    const std::int64_t stamp_ns = clock.Update(camera.CameraNs(i), receive_ns);
+
+    // also while the jump is not detected yet
+    EXPECT_LE(stamp_ns, receive_ns) << "frame " << i;
+    EXPECT_GT(stamp_ns, previous_ns) << "frame " << i;
+    previous_ns = stamp_ns;
+
+    if ((i < WINDOW) ? (i >= WINDOW / 4) : (i >= WINDOW + WINDOW / 4))
+    {
+      EXPECT_NEAR(stamp_ns, camera.CaptureNs(i) + LATENCY_NS, TOLERANCE_NS) << "frame " << i;
+    }
+  }
+
+  EXPECT_EQ(clock.Resets(), 1u);
+  EXPECT_EQ(clock.Samples(), WINDOW);
+  EXPECT_NEAR(clock.DriftPpm(), DRIFT * 1e6, 5.0);
+}
+
+TEST(ClockEstimator, NoDriftOverShortSpans)
+{
+  ifm3d_ros::ClockEstimator clock(WINDOW);
+  Camera camera;
+
+  // less than a second
+  for (std::size_t i = 0; i < 8; ++i)
+  {
+    clock.Update(camera.CameraNs(i), camera.ReceiveNs(i));
+  }
+
+  EXPECT_EQ(clock.DriftPpm(), 0.0);
+  EXPECT_EQ(clock.Samples(), 8u);
+}
@@ -0,0 +1,591 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/conversions.h>
+#include <ifm3d_ros_driver/frame_source.h>
+#include <ifm3d_ros_driver/point_cloud_kernels.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <gtest/gtest.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <std_msgs/Header.h>
+
+#include <ifm3d/fg.h>
+#include <ifm3d/stlimage.h>
+
+namespace
+{
+const std::string LOGGER = "test_conversions";
+
+// odd sizes, so that the remainders of the vectorized kernels are covered as well
+constexpr std::uint32_t WIDTH = 61;
+constexpr std::uint32_t HEIGHT = 47;
+
+const float* points(const sensor_msgs::PointCloud2& cloud)
+{
+  return reinterpret_cast<const float*>(cloud.data.data());
+}
+
+void ExpectSamePoints(const sensor_msgs::PointCloud2& expected, const sensor_msgs::PointCloud2& actual)
+{
+  ASSERT_EQ(expected.width, actual.width);
+  ASSERT_EQ(expected.height, actual.height);
+  ASSERT_EQ(expected.point_step, actual.point_step);
+  ASSERT_EQ(expected.data.size(), actual.data.size());
+  EXPECT_EQ(expected.header.frame_id, actual.header.frame_id);
+  EXPECT_EQ(expected.is_dense, actual.is_dense);
+
+  const std::size_t n = expected.data.size() / sizeof(float);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const float e = points(expected)[i];
+    const float a = points(actual)[i];
+    if (std::isnan(e))
+    {
+      EXPECT_TRUE(std::isnan(a)) << "at " << i;
+    }
+    else
+    {
+      EXPECT_NEAR(e, a, 1e-5f) << "at " << i;
+    }
+  }
+}
+
+void ExpectSameCloud(const sensor_msgs::PointCloud2& expected, const sensor_msgs::PointCloud2& actual)
+{
+  ASSERT_EQ(expected.width, actual.width);
+  ASSERT_EQ(expected.height, actual.height);
+  ASSERT_EQ(expected.point_step, actual.point_step);
+  ASSERT_EQ(expected.fields.size(), actual.fields.size());
+  EXPECT_EQ(expected.header.frame_id, actual.header.frame_id);
+  EXPECT_EQ(expected.is_dense, actual.is_dense);
+  EXPECT_TRUE(expected.data == actual.data);
+}
+
+// sizes around the lanes of the vectorized kernels and the blocks of `InterleaveFields()`
+const std::vector<std::size_t> SIZES = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 127, 128, 129, 255, 256, 257 };
+
+// `n` points, every `nan_every`th one (if not 0) masked, i.e. NaN in all coordinates
+std::vector<float> MakePoints(std::size_t n, std::size_t nan_every)
+{
+  std::vector<float> xyz(3 * n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const bool masked = (nan_every != 0) && (i % nan_every == 0);
+    for (std::size_t k = 0; k < 3; ++k)
+    {
+      xyz[3 * i + k] =
+          masked ? std::numeric_limits<float>::quiet_NaN() : 0.25f * static_cast<float>(i) - static_cast<float>(k);
+    }
+  }
+  return xyz;
+}
+
+// the 4 byte field of pixel `i` of `channel` as `InterleaveFields()` is expected to store it
+std::uint32_t FieldBits(const ifm3d_ros::Channel& channel, std::size_t i)
+{
+  using Format = ifm3d_ros::Channel::Format;
+
+  const auto* f32 = static_cast<const float*>(channel.data);
+  const auto* u16 = static_cast<const std::uint16_t*>(channel.data);
+  const auto* u8 = static_cast<const std::uint8_t*>(channel.data);
+  std::uint32_t bits = 0;
+  float value = 0.0f;
+  switch (channel.format)
+  {
+    case Format::FLOAT32:
+      value = f32[i];
+      break;
+    case Format::UINT16_TO_FLOAT32:
+      value = static_cast<float>(u16[i]);
+      break;
+    case Format::UINT8_TO_FLOAT32:
+      value = static_cast<float>(u8[i]);
+      break;
+    case Format::UINT16:
+      return u16[i];
+    case Format::UINT8_TO_UINT16:
+      return u8[i];
+  }
+
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// p' = R * p + t with the row-major matrix `m`, in double precision
+void ExpectTransformed(const float* m, const float* p, const float* actual, const std::string& what)
+{
+  for (std::size_t r = 0; r < 3; ++r)
+  {
+    const double expected = static_cast<double>(m[4 * r]) * p[0] + static_cast<double>(m[4 * r + 1]) * p[1] +
+                            static_cast<double>(m[4 * r + 2]) * p[2] + m[4 * r + 3];
+    if (std::isnan(p[0]))
+    {
+      EXPECT_TRUE(std::isnan(actual[r])) << what;
+    }
+    else
+    {
+      EXPECT_NEAR(actual[r], expected, 1e-4) << what;
+    }
+  }
+}
+
+// rotates by 30 degrees about z and translates, the last row is not used
+const std::array<float, 16> TRANSFORM = { 0.866025f, -0.5f, 0.0f, 1.5f,  0.5f, 0.866025f, 0.0f, -2.0f,
+                                          0.0f,      0.0f,  1.0f, 0.25f, 7.0f, 7.0f,      7.0f, 7.0f };
+
+// a frame of the mocked head with its cartesian image, unit vectors and radial distance
+void MockFrame(ifm3d::StlImageBuffer& buffer)
+{
+  ifm3d_ros::MockFrameSource source(ifm3d::IMG_CART | ifm3d::IMG_UVEC | ifm3d::IMG_RDIS, WIDTH, HEIGHT, 0.0);
+  source.SWTrigger();
+  ASSERT_TRUE(source.WaitForFrame(&buffer, 1000));
+}
+}  // namespace
+
+TEST(Conversions, ComputedCloudEqualsCartesianImage)
+{
+  ifm3d::StlImageBuffer buffer;
+  ASSERT_NO_FATAL_FAILURE(MockFrame(buffer));
+  ifm3d::Image xyz = buffer.XYZImage();
+  ifm3d::Image uvec = buffer.UnitVectors();
+  ifm3d::Image distance = buffer.DistanceImage();
+  const std::vector<float> extrinsics = buffer.Extrinsics();
+
+  // the mocked head is translated, i.e. the units of the translation matter
+  ASSERT_GE(extrinsics.size(), 3u);
+  ASSERT_NE(extrinsics[0], 0.0f);
+
+  std_msgs::Header header;
+  header.frame_id = "camera_link";
+
+  sensor_msgs::PointCloud2 expected;
+  ifm3d_to_ros_cloud(xyz, header, LOGGER, expected);
+
+  sensor_msgs::PointCloud2 computed;
+  ifm3d_to_ros_cloud(camera_frame_unit_vectors(uvec, LOGGER), distance, extrinsics, header, LOGGER, computed);
+
+  ExpectSamePoints(expected, computed);
+}
+
+TEST(Conversions, ComputedCloudEqualsCartesianImageMasked)
+{
+  ifm3d::StlImageBuffer buffer;
+  ASSERT_NO_FATAL_FAILURE(MockFrame(buffer));
+  ifm3d::Image xyz = buffer.XYZImage();
+  ifm3d::Image uvec = buffer.UnitVectors();
+  ifm3d::Image distance = buffer.DistanceImage();
+  ifm3d::Image confidence = buffer.ConfidenceImage();
+  const std::vector<float> extrinsics = buffer.Extrinsics();
+
+  std_msgs::Header header;
+  header.frame_id = "camera_link";
+
+  sensor_msgs::PointCloud2 expected;
+  ifm3d_to_ros_cloud(xyz, confidence, 0x1, header, LOGGER, expected);
+  EXPECT_FALSE(expected.is_dense);
+
+  sensor_msgs::PointCloud2 computed;
+  ifm3d_to_ros_cloud(camera_frame_unit_vectors(uvec, LOGGER), distance, extrinsics, confidence, 0x1, header, LOGGER,
+                     computed);
+
+  ExpectSamePoints(expected, computed);
+}
+
+TEST(Conversions, RichCloudEqualsInterleavedCloud)
+{
+  const std::size_t n = WIDTH * HEIGHT;
+  ifm3d::Image xyz(WIDTH, HEIGHT, 3, ifm3d::pixel_format::FORMAT_32F3);
+  ifm3d::Image distance(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_32F);
+  ifm3d::Image amplitude(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_32F);
+  ifm3d::Image confidence(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_8U);
+  std::vector<float> uvec(3 * n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::size_t k = 0; k < 3; ++k)
+    {
+      uvec[3 * i + k] = 0.01f * static_cast<float>((i + k) % 13);
+      xyz.ptr<float>(0)[3 * i + k] = 0.1f * static_cast<float>(i) - static_cast<float>(k);
+    }
+    distance.ptr<float>(0)[i] = (i % 11 == 0) ? 0.0f : 0.5f + 0.001f * static_cast<float>(i);
+    amplitude.ptr<float>(0)[i] = static_cast<float>(i);
+    confidence.ptr<std::uint8_t>(0)[i] = static_cast<std::uint8_t>(((i % 17 == 0) ? 0x1 : 0x0) | (i % 5) << 4);
+  }
+  const std::vector<float> extrinsics = { 10.0f, -20.0f, 30.0f, 0.0f, 0.0f, 0.0f };
+
+  const auto fields = make_cloud_fields({ "intensity", "confidence" });
+  std::vector<ifm3d::Image> images = { amplitude, confidence };
+  std_msgs::Header header;
+  header.frame_id = "camera_link";
+
+  // the same points as interleaving the x/y/z cloud afterwards, masked or not
+  for (std::uint16_t invalid_bits : { 0x0, 0x1 })
+  {
+    sensor_msgs::PointCloud2 points;
+    sensor_msgs::PointCloud2 expected;
+    sensor_msgs::PointCloud2 actual;
+    ifm3d_to_ros_cloud(xyz, confidence, invalid_bits, header, LOGGER, points);
+    ifm3d_to_ros_cloud(points, fields, images, LOGGER, expected);
+    ifm3d_to_ros_cloud(xyz, confidence, invalid_bits, fields, images, header, LOGGER, actual);
+    ExpectSameCloud(expected, actual);
+    EXPECT_EQ(actual.is_dense, invalid_bits == 0);
+
+    ifm3d_to_ros_cloud(uvec, distance, extrinsics, confidence, invalid_bits, header, LOGGER, points);
+    ifm3d_to_ros_cloud(points, fields, images, LOGGER, expected);
+    ifm3d_to_ros_cloud(uvec, distance, extrinsics, confidence, invalid_bits, fields, images, header, LOGGER, actual);
+    ExpectSameCloud(expected, actual);
+    EXPECT_EQ(actual.point_step, 20u);
+  }
+}
+
+TEST(Conversions, SparseCloud)
+{
+  const std::size_t n = WIDTH * HEIGHT;
+  ifm3d::Image xyz(WIDTH, HEIGHT, 3, ifm3d::pixel_format::FORMAT_32F3);
+  ifm3d::Image confidence(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_8U);
+  const std::vector<float> unmasked = MakePoints(n, 0);
+  std::copy(unmasked.begin(), unmasked.end(), xyz.ptr<float>(0));
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    confidence.ptr<std::uint8_t>(0)[i] = ((i % 3 == 0) || (i % 7 == 0)) ? 0x1 : 0x0;
+  }
+
+  std_msgs::Header header;
+  header.frame_id = "camera_link";
+  sensor_msgs::PointCloud2 organized;
+  ifm3d_to_ros_cloud(xyz, confidence, 0x1, header, LOGGER, organized);
+
+  for (bool pixel_index : { false, true })
+  {
+    sensor_msgs::PointCloud2 sparse;
+    ifm3d_to_ros_sparse_cloud(organized, pixel_index, sparse);
+    ASSERT_EQ(sparse.fields.size(), pixel_index ? 4u : 3u);
+    ASSERT_EQ(sparse.point_step, pixel_index ? 16u : 12u);
+    EXPECT_EQ(sparse.height, 1u);
+    EXPECT_EQ(sparse.row_step, sparse.point_step * sparse.width);
+    ASSERT_EQ(sparse.data.size(), sparse.row_step);
+    EXPECT_EQ(sparse.header.frame_id, header.frame_id);
+    EXPECT_TRUE(sparse.is_dense);
+
+    // the unmasked points, in order
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      if (std::isnan(points(organized)[3 * i]))
+      {
+        continue;
+      }
+
+      ASSERT_LT(count, sparse.width);
+      const std::uint8_t* point = sparse.data.data() + sparse.point_step * count;
+      EXPECT_EQ(std::memcmp(point, points(organized) + 3 * i, 3 * sizeof(float)), 0) << "at " << i;
+      if (pixel_index)
+      {
+        std::uint32_t index;
+        std::memcpy(&index, point + 12, sizeof(index));
+        EXPECT_EQ(index, i);
+      }
+      ++count;
+    }
+    EXPECT_EQ(sparse.width, count);
+  }
+
+  // not an x/y/z-only cloud
+  const auto fields = make_cloud_fields({ "confidence" });
+  std::vector<ifm3d::Image> images = { confidence };
+  sensor_msgs::PointCloud2 rich;
+  ifm3d_to_ros_cloud(organized, fields, images, LOGGER, rich);
+  sensor_msgs::PointCloud2 sparse;
+  ifm3d_to_ros_sparse_cloud(rich, false, sparse);
+  EXPECT_EQ(sparse.width, 0u);
+  EXPECT_TRUE(sparse.data.empty());
+}
+
+TEST(Conversions, MergeClouds)
+{
+  std_msgs::Header header;
+  header.frame_id = "vpu";
+
+  // an x/y/z cloud with masked points, one with an extra field and one without x, y, z
+  ifm3d::Image xyz(WIDTH, HEIGHT, 3, ifm3d::pixel_format::FORMAT_32F3);
+  ifm3d::Image confidence(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_8U);
+  const std::size_t n = WIDTH * HEIGHT;
+  const std::vector<float> unmasked = MakePoints(n, 0);
+  std::copy(unmasked.begin(), unmasked.end(), xyz.ptr<float>(0));
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    confidence.ptr<std::uint8_t>(0)[i] = (i % 5 == 0) ? 0x1 : 0x0;
+  }
+
+  auto masked = boost::make_shared<sensor_msgs::PointCloud2>();
+  ifm3d_to_ros_cloud(xyz, confidence, 0x1, header, LOGGER, *masked);
+
+  const auto fields = make_cloud_fields({ "intensity" });
+  std::vector<ifm3d::Image> images = { ifm3d::Image(WIDTH, HEIGHT, 1, ifm3d::pixel_format::FORMAT_32F) };
+  sensor_msgs::PointCloud2 plain;
+  ifm3d_to_ros_cloud(xyz, header, LOGGER, plain);
+  auto rich = boost::make_shared<sensor_msgs::PointCloud2>();
+  ifm3d_to_ros_cloud(plain, fields, images, LOGGER, *rich);
+  ASSERT_EQ(rich->point_step, 16u);
+
+  auto other = boost::make_shared<sensor_msgs::PointCloud2>(plain);
+  other->fields[0].name = "intensity";
+
+  // a 4x4 and a 3x4 matrix, i.e. without the last row
+  std::array<float, 16> affine{};
+  std::copy(TRANSFORM.begin(), TRANSFORM.begin() + 12, affine.begin());
+  const std::vector<sensor_msgs::PointCloud2ConstPtr> clouds = { masked, other, rich };
+  const std::vector<std::array<float, 16>> transforms = { TRANSFORM, TRANSFORM, affine };
+
+  sensor_msgs::PointCloud2 merged;
+  merge_clouds(clouds, transforms, header, LOGGER, merged);
+  ASSERT_EQ(merged.width, 2 * n);
+  EXPECT_EQ(merged.height, 1u);
+  ASSERT_EQ(merged.point_step, 12u);
+  EXPECT_EQ(merged.row_step, merged.point_step * merged.width);
+  ASSERT_EQ(merged.data.size(), merged.row_step);
+  EXPECT_EQ(merged.fields.size(), 3u);
+  EXPECT_EQ(merged.header.frame_id, "vpu");
+  EXPECT_FALSE(merged.is_dense);
+
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    ExpectTransformed(TRANSFORM.data(), points(*masked) + 3 * i, points(merged) + 3 * i, "masked cloud");
+    ExpectTransformed(TRANSFORM.data(), unmasked.data() + 3 * i, points(merged) + 3 * (n + i), "rich cloud");
+  }
+
+  // dense without the masked cloud
+  merge_clouds({ rich }, { TRANSFORM }, header, LOGGER, merged);
+  EXPECT_EQ(merged.width, n);
+  EXPECT_TRUE(merged.is_dense);
+}
+
+TEST(MockFrameSource, AnswersEveryTrigger)
+{
+  ifm3d_ros::MockFrameSource source(ifm3d::IMG_RDIS, WIDTH, HEIGHT, 0.0);
+  ifm3d::StlImageBuffer buffer;
+  EXPECT_FALSE(source.WaitForFrame(&buffer, 1));
+
+  // pipelined triggers
+  source.SWTrigger();
+  source.SWTrigger();
+  source.SWTrigger();
+  for (std::uint32_t i = 1; i <= 3; ++i)
+  {
+    ASSERT_TRUE(source.WaitForFrame(&buffer, 1000));
+    std::uint32_t count;
+    ASSERT_TRUE(source.FrameCount(count));
+    EXPECT_EQ(count, i);
+  }
+
+  EXPECT_FALSE(source.WaitForFrame(&buffer, 1));
+}
+
+TEST(PointCloudKernels, OpticalToCameraFrame)
+{
+  const float optical[6] = { 0.6f, 0.0f, 0.8f, 0.0f, -0.6f, 0.8f };
+  float camera[6];
+  ifm3d_ros::OpticalToCameraFrame(optical, camera, 2);
+
+  // right -> -y, down -> -z, forward -> x
+  EXPECT_FLOAT_EQ(camera[0], 0.8f);
+  EXPECT_FLOAT_EQ(camera[1], -0.6f);
+  EXPECT_FLOAT_EQ(camera[2], 0.0f);
+  EXPECT_FLOAT_EQ(camera[3], 0.8f);
+  EXPECT_FLOAT_EQ(camera[4], 0.0f);
+  EXPECT_FLOAT_EQ(camera[5], 0.6f);
+}
+
+TEST(PointCloudKernels, ComputeXYZ)
+{
+  const std::size_t n = WIDTH * HEIGHT;
+  std::vector<float> uvec(3 * n);
+  std::vector<float> distance(n);
+  std::vector<std::uint8_t> confidence(n);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    uvec[3 * i + 0] = 0.01f * static_cast<float>(i % 13);
+    uvec[3 * i + 1] = -0.02f * static_cast<float>(i % 7);
+    uvec[3 * i + 2] = 1.0f;
+    distance[i] = (i % 11 == 0) ? 0.0f : 0.5f + 0.001f * static_cast<float>(i);
+    confidence[i] = (i % 17 == 0) ? 0x1 : 0x0;
+  }
+  const float translation[3] = { 0.1f, -0.2f, 0.3f };
+
+  std::vector<float> xyz(3 * n);
+  ifm3d_ros::Confidence unmasked;
+  EXPECT_EQ(ifm3d_ros::ComputeXYZ(uvec.data(), distance.data(), translation, unmasked, xyz.data(), n), 0u);
+
+  ifm3d_ros::Confidence masked;
+  masked.data = confidence.data();
+  std::vector<float> xyz_masked(3 * n);
+  const std::size_t invalid =
+      ifm3d_ros::ComputeXYZ(uvec.data(), distance.data(), translation, masked, xyz_masked.data(), n);
+
+  std::size_t expected_invalid = 0;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    const bool valid = distance[i] > 0.0f;
+    const bool unmasked_point = valid && (confidence[i] == 0);
+    expected_invalid += unmasked_point ? 0 : 1;
+
+    for (std::size_t k = 0; k < 3; ++k)
+    {
+      const float expected = uvec[3 * i + k] * distance[i] + translation[k];
+      EXPECT_NEAR(xyz[3 * i + k], valid ? expected : 0.0f, 1e-5f) << "at " << i;
+      if (unmasked_point)
+      {
+        EXPECT_NEAR(xyz_masked[3 * i + k], expected, 1e-5f) << "at " << i;
+      }
+      else
+      {
+        EXPECT_TRUE(std::isnan(xyz_masked[3 * i + k])) << "at " << i;
+      }
+    }
+  }
+  EXPECT_EQ(invalid, expected_invalid);
+}
+
+TEST(PointCloudKernels, CompactXYZ)
+{
+  for (std::size_t n : SIZES)
+  {
+    for (std::size_t nan_every : { 0, 1, 2, 3, 5 })
+    {
+      const std::vector<float> xyz = MakePoints(n, nan_every);
+      for (bool pixel_index : { false, true })
+      {
+        // the scalar reference
+        const std::size_t stride = pixel_index ? 4 : 3;
+        std::vector<float> expected;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+          if (!std::isnan(xyz[3 * i]))
+          {
+            expected.insert(expected.end(), xyz.begin() + 3 * i, xyz.begin() + 3 * i + 3);
+            if (pixel_index)
+            {
+              const auto index = static_cast<std::uint32_t>(i);
+              float bits;
+              std::memcpy(&bits, &index, sizeof(bits));
+              expected.push_back(bits);
+            }
+          }
+        }
+
+        std::vector<float> out(stride * n + 1);
+        const std::size_t count = ifm3d_ros::CompactXYZ(xyz.data(), n, pixel_index, out.data());
+        ASSERT_EQ(count * stride, expected.size()) << n << " points, every " << nan_every << " masked";
+        const auto* bytes = reinterpret_cast<const std::uint8_t*>(expected.data());
+        EXPECT_TRUE(std::equal(bytes, bytes + expected.size() * sizeof(float),
+                               reinterpret_cast<const std::uint8_t*>(out.data())))
+            << n << " points, every " << nan_every << " masked, pixel_index " << pixel_index;
+      }
+    }
+  }
+}
+
+TEST(PointCloudKernels, InterleaveFields)
+{
+  using Format = ifm3d_ros::Channel::Format;
+
+  const std::size_t max_n = SIZES.back();
+  std::vector<float> f32(max_n);
+  std::vector<std::uint16_t> u16(max_n);
+  std::vector<std::uint8_t> u8(max_n);
+  for (std::size_t i = 0; i < max_n; ++i)
+  {
+    f32[i] = 0.5f * static_cast<float>(i) - 3.0f;
+    u16[i] = static_cast<std::uint16_t>(40000 + 97 * i);
+    u8[i] = static_cast<std::uint8_t>(200 + 3 * i);
+  }
+
+  const std::vector<ifm3d_ros::Channel> all = {
+    { f32.data(), Format::FLOAT32 },
+    { u16.data(), Format::UINT16_TO_FLOAT32 },
+    { u8.data(), Format::UINT8_TO_FLOAT32 },
+    { u16.data(), Format::UINT16 },
+    { u8.data(), Format::UINT8_TO_UINT16 },
+  };
+
+  // none, every format on its own (i.e. right after the coordinates), all of them in both orders
+  std::vector<std::vector<ifm3d_ros::Channel>> layouts = { {}, all, { all.rbegin(), all.rend() } };
+  for (const auto& channel : all)
+  {
+    layouts.push_back({ channel });
+  }
+
+  for (std::size_t n : SIZES)
+  {
+    const std::vector<float> xyz = MakePoints(n, 3);
+    for (const auto& channels : layouts)
+    {
+      // the scalar reference
+      const std::size_t point_step = 12 + 4 * channels.size();
+      std::vector<std::uint8_t> expected(point_step * n);
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        std::memcpy(expected.data() + point_step * i, xyz.data() + 3 * i, 3 * sizeof(float));
+        for (std::size_t c = 0; c < channels.size(); ++c)
+        {
+          const std::uint32_t bits = FieldBits(channels[c], i);
+          std::memcpy(expected.data() + point_step * i + 12 + 4 * c, &bits, sizeof(bits));
+        }
+      }
+
+      // nothing is written past the points
+      std::vector<std::uint8_t> out(point_step * n + 16, 0xab);
+      ifm3d_ros::InterleaveFields(xyz.data(), channels.data(), channels.size(), n, out.data());
+      EXPECT_TRUE(std::equal(expected.begin(), expected.end(), out.begin()))
+          << n << " points, " << channels.size() << " channels";
+      EXPECT_TRUE(std::all_of(out.begin() + expected.size(), out.end(), [](std::uint8_t b) { return b == 0xab; }))
+          << n << " points, " << channels.size() << " channels";
+    }
+  }
+}
+
+TEST(PointCloudKernels, TransformXYZ)
+{
+  // only 12 values, as the last row is not used
+  const std::vector<float> affine(TRANSFORM.begin(), TRANSFORM.begin() + 12);
+
+  for (std::size_t n : SIZES)
+  {
+    const std::vector<float> xyz = MakePoints(n, 3);
+    for (std::size_t point_step : { 12, 16, 20 })
+    {
+      // the coordinates followed by other fields
+      std::vector<std::uint8_t> src(point_step * n, 0xcd);
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        std::memcpy(src.data() + point_step * i, xyz.data() + 3 * i, 3 * sizeof(float));
+      }
+
+      for (const float* m : { TRANSFORM.data(), affine.data() })
+      {
+        // nothing is written past the points
+        std::vector<float> out(3 * n + 4, 42.0f);
+        ifm3d_ros::TransformXYZ(m, src.data(), point_step, n, out.data());
+
+        const std::string what = std::to_string(n) + " points of " + std::to_string(point_step) + " bytes";
+        for (std::size_t i = 0; i < n; ++i)
+        {
+          ExpectTransformed(m, xyz.data() + 3 * i, out.data() + 3 * i, what);
+        }
+        EXPECT_TRUE(std::all_of(out.begin() + 3 * n, out.end(), [](float v) { return v == 42.0f; })) << what;
+      }
+    }
+  }
+}
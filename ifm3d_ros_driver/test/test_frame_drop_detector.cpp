@@ -0,0 +1,146 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/frame_drop_detector.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+constexpr std::size_t WINDOW = 32;
+constexpr std::int64_t PERIOD_NS = 50000000;  // 20 Hz
+
+// feeds the detector with frames of a camera, counted or at a known cadence
+class Stream
+{
+public:
+  Stream(ifm3d_ros::FrameDropDetector& detector, bool has_count, bool use_cadence, std::uint32_t count = 0)
+    : detector_(detector), has_count_(has_count), use_cadence_(use_cadence), count_(count)
+  {
+  }
+
+  // the camera produced `produced` frames, the last of which reaches the
+  // detector after `skipped` were dropped by the pipeline
+  std::uint64_t Next(std::uint32_t produced = 1, std::uint64_t skipped = 0, std::int64_t jitter_ns = 0)
+  {
+    this->sequence_ += skipped + 1;
+    this->count_ += produced;
+    this->camera_ns_ += produced * PERIOD_NS;
+    return this->detector_.Update(this->sequence_, this->camera_ns_ + jitter_ns, this->has_count_, this->count_,
+                                  this->use_cadence_);
+  }
+
+private:
+  ifm3d_ros::FrameDropDetector& detector_;
+  bool has_count_;
+  bool use_cadence_;
+  std::uint64_t sequence_ = 0;
+  std::uint32_t count_;
+  std::int64_t camera_ns_ = 1000000000;
+};
+}  // namespace
+
+TEST(FrameDropDetector, CountsGapsOfTheFrameCounter)
+{
+  ifm3d_ros::FrameDropDetector detector(WINDOW);
+  Stream stream(detector, true, false);
+
+  EXPECT_EQ(stream.Next(), 0u);
+  EXPECT_EQ(stream.Next(), 0u);
+  EXPECT_EQ(stream.Next(3), 2u);
+  EXPECT_EQ(stream.Next(), 0u);
+  EXPECT_EQ(detector.Dropped(), 2u);
+
+  // frames dropped by the pipeline are not lost by the camera
+  EXPECT_EQ(stream.Next(3, 2), 0u);
+  EXPECT_EQ(stream.Next(4, 1), 2u);
+  EXPECT_EQ(detector.Dropped(), 4u);
+}
+
+TEST(FrameDropDetector, FrameCounterWrapsAround)
+{
+  ifm3d_ros::FrameDropDetector detector(WINDOW);
+  Stream stream(detector, true, false, UINT32_MAX - 3);
+
+  // ..., 0xfffffffe, 0xffffffff, 0, 1, ...
+  for (std::size_t i = 0; i < 6; ++i)
+  {
+    EXPECT_EQ(stream.Next(), 0u) << "frame " << i;
+  }
+  EXPECT_EQ(detector.Dropped(), 0u);
+
+  Stream wrapping(detector, true, false, UINT32_MAX - 1);
+  wrapping.Next();
+  EXPECT_EQ(wrapping.Next(4), 3u);
+}
+
+TEST(FrameDropDetector, IgnoresRestartedCounters)
+{
+  ifm3d_ros::FrameDropDetector detector(WINDOW);
+  Stream stream(detector, true, false, 100000);
+  stream.Next();
+  stream.Next();
+
+  // the camera restarted, its counter starts over
+  EXPECT_EQ(detector.Update(100, 2000000000, true, 1, false), 0u);
+  EXPECT_EQ(detector.Update(101, 2050000000, true, 2, false), 0u);
+  EXPECT_EQ(detector.Dropped(), 0u);
+}
+
+TEST(FrameDropDetector, CountsGapsOfTheCadence)
+{
+  ifm3d_ros::FrameDropDetector detector(WINDOW);
+  Stream stream(detector, false, true);
+
+  // the gaps are not known until the period is
+  stream.Next();
+  EXPECT_EQ(stream.Next(3), 0u);
+  EXPECT_EQ(detector.Period(), 0.0);
+
+  for (std::size_t i = 0; i < WINDOW; ++i)
+  {
+    // a few percent of jitter is not a gap
+    EXPECT_EQ(stream.Next(1, 0, (i % 2 == 0) ? 2000000 : -2000000), 0u) << "frame " << i;
+  }
+  EXPECT_NEAR(detector.Period(), PERIOD_NS * 1e-9, 4e-3);
+
+  EXPECT_EQ(stream.Next(3), 2u);
+  EXPECT_EQ(stream.Next(), 0u);
+  EXPECT_EQ(stream.Next(5, 1), 3u);
+  EXPECT_EQ(detector.Dropped(), 5u);
+  EXPECT_NEAR(detector.Period(), PERIOD_NS * 1e-9, 4e-3);
+}
+
+TEST(FrameDropDetector, NoCadenceWhenTriggered)
+{
+  ifm3d_ros::FrameDropDetector detector(WINDOW);
+  Stream stream(detector, false, false);
+
+  for (std::size_t i = 0; i < WINDOW; ++i)
+  {
+    stream.Next();
+  }
+
+  // software triggered frames arrive whenever they were triggered
+  EXPECT_EQ(stream.Next(10), 0u);
+  EXPECT_EQ(detector.Dropped(), 0u);
+}
+
+TEST(FrameDropDetector, Reset)
+{
+  ifm3d_ros::FrameDropDetector detector(WINDOW);
+  Stream stream(detector, true, false);
+  stream.Next();
+  EXPECT_EQ(stream.Next(2), 1u);
+
+  // the frames missed while the stream was restarted are not lost ones
+  detector.Reset();
+  EXPECT_EQ(stream.Next(100), 0u);
+  EXPECT_EQ(stream.Next(2), 1u);
+  EXPECT_EQ(detector.Dropped(), 2u);
+}
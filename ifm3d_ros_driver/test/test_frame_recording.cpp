@@ -0,0 +1,218 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/frame_recording.h>
+#include <ifm3d_ros_driver/frame_source.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ftw.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <ifm3d/fg.h>
+#include <ifm3d/stlimage.h>
+
+namespace
+{
+constexpr std::size_t FRAMES = 5;
+
+// a frame of about 0.8 MiB, i.e. every frame is recorded into a segment of its own
+constexpr std::uint16_t MASK = ifm3d::IMG_RDIS | ifm3d::IMG_AMP | ifm3d::IMG_CART;
+constexpr std::uint32_t WIDTH = 224;
+constexpr std::uint32_t HEIGHT = 172;
+constexpr std::size_t SEGMENT_SIZE = 1 << 20;
+
+int remove_entry(const char* path, const struct stat* /* st */, int /* flag */, struct FTW* /* ftw */)
+{
+  return ::remove(path);
+}
+
+off_t file_size(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  return static_cast<off_t>(file.tellg());
+}
+
+class FrameRecording : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/ifm3d_ros_test_XXXXXX";
+    ASSERT_NE(::mkdtemp(dir), nullptr);
+    this->dir_ = dir;
+    this->recording_ = this->dir_ + "/port2";
+  }
+
+  void TearDown() override
+  {
+    if (!this->dir_.empty())
+    {
+      ::nftw(this->dir_.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+  }
+
+  // records `FRAMES` frames of the mocked head, along with their frame counters
+  void Record()
+  {
+    ifm3d_ros::MockFrameSource source(MASK, WIDTH, HEIGHT, 0.0);
+    ifm3d_ros::FrameRecorder recorder(this->recording_, SEGMENT_SIZE);
+    ifm3d::StlImageBuffer buffer;
+    for (std::size_t i = 0; i < FRAMES; ++i)
+    {
+      source.SWTrigger();
+      ASSERT_TRUE(source.WaitForFrame(&buffer, 1000));
+
+      std::uint32_t count;
+      ASSERT_TRUE(source.FrameCount(count));
+      this->frames_.push_back(buffer.Bytes());
+      this->counts_.push_back(count);
+      recorder.Append(this->frames_.back(), static_cast<std::int64_t>(i) * 100000000);
+    }
+
+    EXPECT_EQ(recorder.Frames(), FRAMES);
+  }
+
+  // replays the recording to its end and expects the recorded frames, but those in `missing`
+  void ExpectReplayed(const std::vector<std::size_t>& missing = {})
+  {
+    ifm3d_ros::ReplayFrameSource replay(this->recording_, 0.0, false);
+    EXPECT_EQ(replay.Frames(), FRAMES - missing.size());
+
+    ifm3d::StlImageBuffer buffer;
+    for (std::size_t i = 0; i < FRAMES; ++i)
+    {
+      if (std::find(missing.begin(), missing.end(), i) != missing.end())
+      {
+        continue;
+      }
+
+      ASSERT_TRUE(replay.WaitForFrame(&buffer, 1000)) << "frame " << i;
+      EXPECT_EQ(buffer.Bytes(), this->frames_[i]) << "frame " << i;
+
+      std::uint32_t count;
+      ASSERT_TRUE(replay.FrameCount(count));
+      EXPECT_EQ(count, this->counts_[i]);
+    }
+
+    // the end of the recording, without looping
+    EXPECT_FALSE(replay.WaitForFrame(&buffer, 1));
+  }
+
+  std::string dir_;
+  std::string recording_;
+  std::vector<std::vector<std::uint8_t>> frames_;
+  std::vector<std::uint32_t> counts_;
+};
+}  // namespace
+
+TEST_F(FrameRecording, ReplaysTheRecordedFrames)
+{
+  ASSERT_NO_FATAL_FAILURE(this->Record());
+  ASSERT_GT(this->frames_.front().size(), SEGMENT_SIZE / 2);
+  this->ExpectReplayed();
+}
+
+TEST_F(FrameRecording, LoopsOverTheRecording)
+{
+  ASSERT_NO_FATAL_FAILURE(this->Record());
+
+  ifm3d_ros::ReplayFrameSource replay(this->recording_, 0.0, true);
+  ifm3d::StlImageBuffer buffer;
+  for (std::size_t i = 0; i < 2 * FRAMES; ++i)
+  {
+    ASSERT_TRUE(replay.WaitForFrame(&buffer, 1000));
+    EXPECT_EQ(buffer.Bytes(), this->frames_[i % FRAMES]) << "frame " << i;
+  }
+}
+
+TEST_F(FrameRecording, RefusesToOverwriteARecording)
+{
+  ASSERT_NO_FATAL_FAILURE(this->Record());
+  EXPECT_THROW(ifm3d_ros::FrameRecorder(this->recording_, SEGMENT_SIZE), std::runtime_error);
+}
+
+TEST_F(FrameRecording, TruncatedIndex)
+{
+  ASSERT_NO_FATAL_FAILURE(this->Record());
+
+  // the recorder died while writing the entry of the last frame
+  const std::string index = this->recording_ + "/index";
+  ASSERT_EQ(::truncate(index.c_str(), file_size(index) - sizeof(ifm3d_ros::RecordingIndexEntry) / 2), 0);
+  this->ExpectReplayed({ FRAMES - 1 });
+
+  // no frames at all
+  ASSERT_EQ(::truncate(index.c_str(), sizeof(ifm3d_ros::RecordingIndexHeader)), 0);
+  EXPECT_THROW(ifm3d_ros::ReplayFrameSource(this->recording_, 0.0, false), std::runtime_error);
+
+  // not even a header
+  ASSERT_EQ(::truncate(index.c_str(), sizeof(ifm3d_ros::RecordingIndexHeader) / 2), 0);
+  EXPECT_THROW(ifm3d_ros::ReplayFrameSource(this->recording_, 0.0, false), std::runtime_error);
+}
+
+TEST_F(FrameRecording, TruncatedSegment)
+{
+  ASSERT_NO_FATAL_FAILURE(this->Record());
+
+  // a frame which is not completely in its segment is dropped, the others are replayed
+  const std::string segment = this->recording_ + "/segment_000002.pcic";
+  ASSERT_EQ(file_size(segment), static_cast<off_t>(this->frames_[2].size()));
+  ASSERT_EQ(::truncate(segment.c_str(), file_size(segment) - 1), 0);
+  this->ExpectReplayed({ 2 });
+
+  // as is a missing segment
+  ASSERT_EQ(::unlink((this->recording_ + "/segment_000000.pcic").c_str()), 0);
+  this->ExpectReplayed({ 0, 2 });
+}
+
+TEST_F(FrameRecording, UnitVectorCacheRoundTrip)
+{
+  ASSERT_NO_FATAL_FAILURE(this->Record());
+  const std::vector<std::uint8_t>& frame = this->frames_.front();
+
+  ifm3d_ros::UnitVectorCache cache(this->dir_ + "/unit_vectors");
+  const std::string key = ifm3d_ros::UnitVectorCache::Key("0000/123", "port2", "{\"config\": 1}");
+  EXPECT_EQ(key.find('/'), std::string::npos);
+  EXPECT_NE(key, ifm3d_ros::UnitVectorCache::Key("0000/123", "port2", "{\"config\": 2}"));
+
+  std::vector<std::uint8_t> loaded;
+  EXPECT_FALSE(cache.Load(key, loaded));
+
+  cache.Store(key, frame);
+  ASSERT_TRUE(cache.Load(key, loaded));
+  EXPECT_EQ(loaded, frame);
+
+  // a single flipped bit of the frame fails the checksum
+  {
+    std::fstream file(cache.Dir() + "/" + key + ".uvec", std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(sizeof(ifm3d_ros::UnitVectorCacheHeader) + frame.size() / 2);
+    const char byte = static_cast<char>(file.get());
+    file.seekp(sizeof(ifm3d_ros::UnitVectorCacheHeader) + frame.size() / 2);
+    file.put(static_cast<char>(byte ^ 0x10));
+  }
+
+  loaded.clear();
+  EXPECT_FALSE(cache.Load(key, loaded));
+  EXPECT_TRUE(loaded.empty());
+
+  // as does a truncated frame, which is then replaced
+  cache.Store(key, frame);
+  const std::string path = cache.Dir() + "/" + key + ".uvec";
+  ASSERT_EQ(::truncate(path.c_str(), file_size(path) - 1), 0);
+  EXPECT_FALSE(cache.Load(key, loaded));
+
+  cache.Store(key, frame);
+  ASSERT_TRUE(cache.Load(key, loaded));
+  EXPECT_EQ(loaded, frame);
+}
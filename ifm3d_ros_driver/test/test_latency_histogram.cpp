@@ -0,0 +1,131 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/latency_histogram.h>
+
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+// the bucket of a value is at most 1/32 of it wide
+void ExpectBucketOf(std::uint64_t value, std::uint64_t bound)
+{
+  EXPECT_GE(bound, value);
+  EXPECT_LE(bound, value + value / 32) << "of " << value;
+}
+}  // namespace
+
+TEST(LatencyHistogram, Empty)
+{
+  ifm3d_ros::LatencyHistogram histogram;
+  const auto summary = histogram.Drain();
+  EXPECT_EQ(summary.count, 0u);
+  EXPECT_EQ(summary.p50, 0u);
+  EXPECT_EQ(summary.p90, 0u);
+  EXPECT_EQ(summary.p99, 0u);
+  EXPECT_EQ(summary.max, 0u);
+}
+
+TEST(LatencyHistogram, SmallValuesAreExact)
+{
+  ifm3d_ros::LatencyHistogram histogram;
+  for (std::uint64_t ns = 0; ns < 32; ++ns)
+  {
+    histogram.Record(ns);
+  }
+
+  // ranks 16, 29 and 32 of 32
+  const auto summary = histogram.Drain();
+  EXPECT_EQ(summary.count, 32u);
+  EXPECT_EQ(summary.p50, 15u);
+  EXPECT_EQ(summary.p90, 28u);
+  EXPECT_EQ(summary.p99, 31u);
+  EXPECT_EQ(summary.max, 31u);
+}
+
+TEST(LatencyHistogram, BucketBounds)
+{
+  // powers of two, their neighbours and everything in between, up to about 5 hours
+  for (std::uint64_t value = 1; value < (std::uint64_t(1) << 44); value = value * 5 / 3 + 1)
+  {
+    for (std::uint64_t ns : { value, value - 1, value + 1 })
+    {
+      ifm3d_ros::LatencyHistogram histogram;
+
+      // a larger value keeps the bounds from being clamped to the maximum
+      histogram.Record(ns);
+      histogram.Record(4 * ns + 64);
+
+      const auto summary = histogram.Drain();
+      ASSERT_EQ(summary.count, 2u);
+      ExpectBucketOf(ns, summary.p50);
+      EXPECT_EQ(summary.max, 4 * ns + 64);
+      EXPECT_EQ(summary.p99, summary.max);
+    }
+  }
+}
+
+TEST(LatencyHistogram, Percentiles)
+{
+  ifm3d_ros::LatencyHistogram histogram;
+
+  // 1 to 1000 us, in reverse so the order does not matter
+  for (std::uint64_t us = 1000; us > 0; --us)
+  {
+    histogram.Record(us * 1000);
+  }
+
+  const auto summary = histogram.Drain();
+  EXPECT_EQ(summary.count, 1000u);
+  ExpectBucketOf(500000, summary.p50);
+  ExpectBucketOf(900000, summary.p90);
+  ExpectBucketOf(990000, summary.p99);
+  EXPECT_EQ(summary.max, 1000000u);
+  EXPECT_LE(summary.p50, summary.p90);
+  EXPECT_LE(summary.p90, summary.p99);
+  EXPECT_LE(summary.p99, summary.max);
+}
+
+TEST(LatencyHistogram, PercentilesDoNotExceedTheMaximum)
+{
+  ifm3d_ros::LatencyHistogram histogram;
+  histogram.Record(1000);
+
+  const auto summary = histogram.Drain();
+  EXPECT_EQ(summary.p50, 1000u);
+  EXPECT_EQ(summary.p99, 1000u);
+  EXPECT_EQ(summary.max, 1000u);
+}
+
+TEST(LatencyHistogram, DrainResets)
+{
+  ifm3d_ros::LatencyHistogram histogram;
+  histogram.Record(123456);
+  EXPECT_EQ(histogram.Drain().count, 1u);
+
+  const auto summary = histogram.Drain();
+  EXPECT_EQ(summary.count, 0u);
+  EXPECT_EQ(summary.max, 0u);
+
+  histogram.Record(42);
+  EXPECT_EQ(histogram.Drain().max, 42u);
+}
+
+TEST(LatencyHistogram, ValuesBeyondTheRange)
+{
+  ifm3d_ros::LatencyHistogram histogram;
+  const std::uint64_t huge = std::uint64_t(1) << 60;
+  histogram.Record(huge);
+  histogram.Record(UINT64_MAX);
+
+  // counted in the last bucket, the maximum is still exact
+  const auto summary = histogram.Drain();
+  EXPECT_EQ(summary.count, 2u);
+  EXPECT_EQ(summary.max, UINT64_MAX);
+  EXPECT_GT(summary.p50, std::uint64_t(1) << 45);
+  EXPECT_LE(summary.p99, summary.max);
+}
@@ -0,0 +1,190 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2021 ifm electronic, gmbh
+ */
+
+#include <ifm3d_ros_driver/spsc_queue.h>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+TEST(SpscQueue, FullAndEmpty)
+{
+  ifm3d_ros::SpscQueue<int> queue(3);
+  EXPECT_EQ(queue.Capacity(), 3u);
+  EXPECT_EQ(queue.Size(), 0u);
+
+  int item = 0;
+  EXPECT_FALSE(queue.TryPop(item));
+
+  for (int i = 1; i <= 3; ++i)
+  {
+    item = i;
+    EXPECT_TRUE(queue.TryPush(item));
+  }
+
+  item = 4;
+  EXPECT_FALSE(queue.TryPush(item));
+  EXPECT_EQ(queue.Size(), 3u);
+  EXPECT_EQ(queue.Peak(), 3u);
+
+  for (int i = 1; i <= 3; ++i)
+  {
+    ASSERT_TRUE(queue.TryPop(item));
+    EXPECT_EQ(item, i);
+  }
+
+  EXPECT_FALSE(queue.TryPop(item));
+  EXPECT_EQ(queue.Size(), 0u);
+
+  // the peak since the previous call
+  EXPECT_EQ(queue.Peak(), 3u);
+  EXPECT_EQ(queue.Peak(), 0u);
+}
+
+TEST(SpscQueue, MinimumCapacity)
+{
+  ifm3d_ros::SpscQueue<int> queue(0);
+  EXPECT_EQ(queue.Capacity(), 1u);
+
+  int item = 1;
+  EXPECT_TRUE(queue.TryPush(item));
+  EXPECT_FALSE(queue.TryPush(item));
+}
+
+TEST(SpscQueue, WrapsAround)
+{
+  // the indices run over the end of the slots several times, at different fill levels
+  ifm3d_ros::SpscQueue<int> queue(3);
+  int next_push = 0;
+  int next_pop = 0;
+  for (int round = 0; round < 20; ++round)
+  {
+    while (queue.Size() < static_cast<std::size_t>(1 + round % 3))
+    {
+      int item = next_push++;
+      ASSERT_TRUE(queue.TryPush(item));
+    }
+
+    int item;
+    ASSERT_TRUE(queue.TryPop(item));
+    EXPECT_EQ(item, next_pop++);
+  }
+
+  int item;
+  while (queue.TryPop(item))
+  {
+    EXPECT_EQ(item, next_pop++);
+  }
+  EXPECT_EQ(next_pop, next_push);
+}
+
+TEST(SpscQueue, FullQueueLeavesTheItem)
+{
+  ifm3d_ros::SpscQueue<std::unique_ptr<int>> queue(1);
+
+  std::unique_ptr<int> first(new int(1));
+  EXPECT_TRUE(queue.TryPush(first));
+  EXPECT_FALSE(first);
+
+  std::unique_ptr<int> second(new int(2));
+  EXPECT_FALSE(queue.TryPush(second));
+  ASSERT_TRUE(second);
+  EXPECT_EQ(*second, 2);
+
+  std::unique_ptr<int> item;
+  ASSERT_TRUE(queue.TryPop(item));
+  ASSERT_TRUE(item);
+  EXPECT_EQ(*item, 1);
+}
+
+TEST(SpscQueue, WaitPopTimesOut)
+{
+  ifm3d_ros::SpscQueue<int> queue(2);
+
+  int item = 0;
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(queue.WaitPop(item, std::chrono::milliseconds(20)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+}
+
+TEST(SpscQueue, WaitPopWakesUpOnPush)
+{
+  ifm3d_ros::SpscQueue<int> queue(2);
+
+  std::thread producer([&queue] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int item = 42;
+    queue.TryPush(item);
+  });
+
+  int item = 0;
+  EXPECT_TRUE(queue.WaitPop(item));
+  EXPECT_EQ(item, 42);
+  producer.join();
+
+  producer = std::thread([&queue] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int item = 43;
+    queue.TryPush(item);
+  });
+
+  EXPECT_TRUE(queue.WaitPop(item, std::chrono::seconds(10)));
+  EXPECT_EQ(item, 43);
+  producer.join();
+}
+
+TEST(SpscQueue, CloseWakesUpTheConsumer)
+{
+  ifm3d_ros::SpscQueue<int> queue(2);
+
+  std::thread closer([&queue] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.Close();
+  });
+
+  int item = 0;
+  EXPECT_FALSE(queue.WaitPop(item));
+  closer.join();
+
+  // items pushed before are still handed out, then it does not block any more
+  item = 1;
+  EXPECT_TRUE(queue.TryPush(item));
+  EXPECT_TRUE(queue.WaitPop(item));
+  EXPECT_EQ(item, 1);
+  EXPECT_FALSE(queue.WaitPop(item));
+  EXPECT_FALSE(queue.WaitPop(item, std::chrono::seconds(10)));
+}
+
+TEST(SpscQueue, ProducerAndConsumer)
+{
+  constexpr int ITEMS = 100000;
+  ifm3d_ros::SpscQueue<int> queue(4);
+
+  std::thread producer([&queue] {
+    for (int i = 0; i < ITEMS; ++i)
+    {
+      int item = i;
+      while (!queue.TryPush(item))
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // every item arrives once, in order
+  for (int i = 0; i < ITEMS; ++i)
+  {
+    int item = -1;
+    ASSERT_TRUE(queue.WaitPop(item, std::chrono::seconds(10)));
+    ASSERT_EQ(item, i);
+  }
+
+  producer.join();
+  EXPECT_EQ(queue.Size(), 0u);
+  EXPECT_LE(queue.Peak(), queue.Capacity());
+}